@@ -13,8 +13,10 @@ function(configure_executable EXECUTABLE_NAME)
     target_link_libraries(${EXECUTABLE_NAME} PUBLIC ${Boost_LIBRARIES})
 
 
-    # Include Eigen
+    # Include Eigen, and let the tests check that their own code doesn't allocate Eigen objects through
+    # Eigen::internal::set_is_malloc_allowed(false). The installed library is built without these checks
     target_link_libraries(${EXECUTABLE_NAME} PUBLIC Eigen3::Eigen)
+    target_compile_definitions(${EXECUTABLE_NAME} PRIVATE EIGEN_RUNTIME_NO_MALLOC)
 
 
     # Include cpputil
@@ -13,3 +13,6 @@ target_link_libraries(${LIBRARY_NAME} PUBLIC Eigen3::Eigen)
 # Include libint2
 target_include_directories(${LIBRARY_NAME} PUBLIC ${libint2_INCLUDE_DIRS})
 target_link_libraries(${LIBRARY_NAME} PUBLIC ${libint2_LIBRARIES})
+
+# Include the threading library
+target_link_libraries(${LIBRARY_NAME} PUBLIC Threads::Threads)
@@ -11,4 +11,7 @@ find_package(Eigen3 3.3.4 REQUIRED)
 find_package(cpputil 1.5.0 REQUIRED)
 
 # Find libint
-find_package(libint2 REQUIRED)
+find_package(libint2 2.6.0 REQUIRED)
+
+# Find the threading library
+find_package(Threads REQUIRED)
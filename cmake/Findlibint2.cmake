@@ -7,6 +7,7 @@
 #  libint2_FOUND            libint2 is available on the system
 #  libint2_INCLUDE_DIRS     the libint2 include directories + dependency include directories
 #  libint2_LIBRARIES        the libint2 library + dependency libraries
+#  libint2_VERSION          the version of the libint2 installation
 
 
 
@@ -17,6 +18,17 @@ find_path(LIBINT_PREFIX include/libint2.hpp HINTS /usr/local/libint/*/)
 if("${LIBINT_PREFIX}" STREQUAL "LIBINT_PREFIX-NOTFOUND")
     message(WARNING "libint2 was not found in the default location /usr/local/libint/x.y.z")
 else()
+    # Read the version from the configuration header, and check it against the requested minimum version
+    file(STRINGS "${LIBINT_PREFIX}/include/libint2/config.h" libint2_version_defines REGEX "#define LIBINT_(MAJOR|MINOR|MICRO)_VERSION")
+    foreach(component MAJOR MINOR MICRO)
+        string(REGEX REPLACE ".*#define LIBINT_${component}_VERSION ([0-9]+).*" "\\1" libint2_${component}_VERSION "${libint2_version_defines}")
+    endforeach()
+    set(libint2_VERSION "${libint2_MAJOR_VERSION}.${libint2_MINOR_VERSION}.${libint2_MICRO_VERSION}")
+
+    if(libint2_FIND_VERSION AND ("${libint2_VERSION}" VERSION_LESS "${libint2_FIND_VERSION}"))
+        message(FATAL_ERROR "libint2 ${libint2_VERSION} was found in ${LIBINT_PREFIX}, but at least version ${libint2_FIND_VERSION} is required")
+    endif()
+
     # Set FOUND
     set(libint2_FOUND TRUE)
 
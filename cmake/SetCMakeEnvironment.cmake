@@ -34,8 +34,11 @@ set(PROJECT_SOURCE_FILES
         ${PROJECT_SOURCE_FOLDER}/AddressingScheme.cpp
         ${PROJECT_SOURCE_FOLDER}/AOBasis.cpp
         ${PROJECT_SOURCE_FOLDER}/Atom.cpp
+        ${PROJECT_SOURCE_FOLDER}/BasisSetLibrary.cpp
         ${PROJECT_SOURCE_FOLDER}/ONV.cpp
         ${PROJECT_SOURCE_FOLDER}/elements.cpp
+        ${PROJECT_SOURCE_FOLDER}/EnginePool.cpp
+        ${PROJECT_SOURCE_FOLDER}/IntegralCache.cpp
         ${PROJECT_SOURCE_FOLDER}/JacobiRotationParameters.cpp
         ${PROJECT_SOURCE_FOLDER}/LibintCommunicator.cpp
         ${PROJECT_SOURCE_FOLDER}/miscellaneous.cpp
@@ -60,8 +63,11 @@ set(PROJECT_INCLUDE_FILES
         ${PROJECT_INCLUDE_FOLDER}/AddressingScheme.hpp
         ${PROJECT_INCLUDE_FOLDER}/AOBasis.hpp
         ${PROJECT_INCLUDE_FOLDER}/Atom.hpp
+        ${PROJECT_INCLUDE_FOLDER}/BasisSetLibrary.hpp
         ${PROJECT_INCLUDE_FOLDER}/common.hpp
         ${PROJECT_INCLUDE_FOLDER}/elements.hpp
+        ${PROJECT_INCLUDE_FOLDER}/EnginePool.hpp
+        ${PROJECT_INCLUDE_FOLDER}/IntegralCache.hpp
         ${PROJECT_INCLUDE_FOLDER}/JacobiRotationParameters.hpp
         ${PROJECT_INCLUDE_FOLDER}/LibintCommunicator.hpp
         ${PROJECT_INCLUDE_FOLDER}/miscellaneous.hpp
@@ -81,7 +87,10 @@ set(PROJECT_TEST_SOURCE_FILES
         ${PROJECT_TESTS_FOLDER}/AddressingScheme_test.cpp
         ${PROJECT_TESTS_FOLDER}/AOBasis_test.cpp
         ${PROJECT_TESTS_FOLDER}/Atom_test.cpp
+        ${PROJECT_TESTS_FOLDER}/BasisSetLibrary_test.cpp
         ${PROJECT_TESTS_FOLDER}/elements_test.cpp
+        ${PROJECT_TESTS_FOLDER}/EnginePool_test.cpp
+        ${PROJECT_TESTS_FOLDER}/IntegralCache_test.cpp
         ${PROJECT_TESTS_FOLDER}/JacobiRotationParameters_test.cpp
         ${PROJECT_TESTS_FOLDER}/LibintCommunicator_test.cpp
         ${PROJECT_TESTS_FOLDER}/miscellaneous_test.cpp
@@ -5,6 +5,9 @@
 #include "Atom.hpp"
 #include "Molecule.hpp"
 
+#include <mutex>
+#include <vector>
+
 #include <Eigen/Dense>
 #include <libint2.hpp>
 
@@ -20,20 +23,58 @@ namespace GQCG {
 class AOBasis {
 private:
     const std::vector<GQCG::Atom> atoms;
+    const std::string basis_set_name;
     const libint2::BasisSet basis_functions;
     const size_t number_of_basis_functions;
 
+    mutable std::mutex schwarz_bounds_mutex;  // protects the lazily calculated Schwarz bounds
+    mutable Eigen::MatrixXd schwarz_bounds;  // the Schwarz bounds sqrt(max|(ab|ab)|) for every shell pair (a,b), empty until first use
+
+
+    // PRIVATE METHODS
+    /**
+     *  @return the shells of the given @param ao_basis, moved to the position of the corresponding atom in the given
+     *  @param atoms, which should have the same atomic numbers in the same order
+     */
+    static libint2::BasisSet recenteredBasisFunctions(const AOBasis& ao_basis, const std::vector<GQCG::Atom>& atoms);
+
+
 public:
-    // CONSTRUCTOR
+    // CONSTRUCTORS
     AOBasis(const GQCG::Molecule& molecule, std::string basis_set);
 
+    /**
+     *  Copy constructor, which also copies the Schwarz bounds if they were already calculated
+     */
+    AOBasis(const AOBasis& ao_basis);
+
+    /**
+     *  Constructor based on the shells of a given @param ao_basis, moved to the position of the corresponding atom in the
+     *  given @param atoms, which should have the same atomic numbers in the same order
+     *
+     *  This is much cheaper than constructing a new AOBasis, since the basis set doesn't have to be read or assembled
+     *  again. The Schwarz bounds are calculated on their first use
+     */
+    AOBasis(const AOBasis& ao_basis, const std::vector<GQCG::Atom>& atoms);
+
 
     // GETTERS
     size_t get_number_of_basis_functions() const { return this->number_of_basis_functions; }
+    const std::string& get_basis_set_name() const { return this->basis_set_name; }
+    const std::vector<GQCG::Atom>& get_atoms() const { return this->atoms; }
+
+    /**
+     *  @return the Schwarz bounds sqrt(max|(ab|ab)|) for every shell pair (a,b)
+     *
+     *  They are calculated on first use, which is thread-safe, and are cached afterwards: bases that are never used for
+     *  screened two-electron integrals (e.g. auxiliary bases) don't pay for them
+     */
+    const Eigen::MatrixXd& get_schwarz_bounds() const;
 
 
     // FRIEND CLASSES
     friend class HamiltonianParameters;
+    friend class IntegralCache;
     friend class LibintCommunicator;
     friend class DOCI;
 };
@@ -0,0 +1,93 @@
+#ifndef GQCG_BASISSETLIBRARY_HPP
+#define GQCG_BASISSETLIBRARY_HPP
+
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <libint2.hpp>
+
+
+namespace GQCG {
+
+
+/**
+ *  A singleton class that caches the parsed basis sets, so that every basis set file is only read once per process
+ *
+ *  The basis sets are stored as libint2 element bases: for every atomic number, the shells (centered at the origin)
+ *  of that element. Constructing a libint2::BasisSet from these is a lot cheaper than reading and parsing the file again
+ *
+ *  Singleton class template from (https://stackoverflow.com/a/1008289)
+ */
+class BasisSetLibrary {
+public:
+    using ElementBases = std::vector<std::vector<libint2::Shell>>;  // the shells of every element, indexed by atomic number
+
+
+private:
+    std::mutex mutex;  // protects the cached element bases
+    std::map<std::string, std::shared_ptr<const ElementBases>> element_bases;  // keyed by the canonical basis set name
+
+
+    /**
+     *  Private constructor as required by the singleton class design
+     */
+    BasisSetLibrary() = default;
+
+    /**
+     *  @return if the basis set with the given @param canonical_name uses Cartesian d-shells by (Gaussian) convention,
+     *  as libint2::BasisSet does
+     */
+    static bool usesCartesianD(const std::string& canonical_name);
+
+public:
+    /**
+     *  @return the static singleton instance
+     */
+    static BasisSetLibrary& get();
+
+
+    /**
+     *  Remove the public copy constructor and a public assignment operator
+     */
+    BasisSetLibrary(BasisSetLibrary const& basis_set_library) = delete;
+    void operator=(BasisSetLibrary const& basis_set_library) = delete;
+
+
+    // PUBLIC METHODS
+    /**
+     *  @return the element bases of the basis set with the given @param basis_set_name
+     *
+     *  The basis set file is read the first time a basis set is requested, and is cached afterwards. Names that only
+     *  differ in the way libint2 canonicalizes them (e.g. "STO-3G" and "sto-3g") share the same element bases
+     *
+     *  The file is read without holding the lock of the cache: concurrent first requests for the same basis set may
+     *  both read it, but they all get the element bases that were cached first
+     */
+    std::shared_ptr<const ElementBases> elementBases(const std::string& basis_set_name);
+
+    /**
+     *  @return a libint2::BasisSet for the given @param basis_set_name on the given @param atoms, assembled from the
+     *  cached element bases
+     */
+    libint2::BasisSet basisSet(const std::string& basis_set_name, const std::vector<libint2::Atom>& atoms);
+
+    /**
+     *  @return the number of basis sets that are currently cached
+     */
+    size_t numberOfCachedBasisSets();
+
+    /**
+     *  Remove all the cached basis sets
+     */
+    void clear();
+};
+
+
+}  // namespace GQCG
+
+
+#endif  // GQCG_BASISSETLIBRARY_HPP
@@ -0,0 +1,100 @@
+#ifndef GQCG_ENGINEPOOL_HPP
+#define GQCG_ENGINEPOOL_HPP
+
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+#include <libint2.hpp>
+
+
+namespace GQCG {
+
+
+/**
+ *  A thread-safe pool of libint2::Engines, keyed by their operator type, maximum number of primitives, maximum
+ *  angular momentum and derivative order
+ *
+ *  Engines are checked out through a Lease, which returns the engine to the pool when it goes out of scope, so that
+ *  the next caller can reuse it instead of constructing a new one. Note that a returned engine keeps the parameters
+ *  (e.g. point charges) and precision that were last set on it: callers should set the ones they need
+ */
+class EnginePool {
+private:
+    using Key = std::tuple<libint2::Operator, size_t, int, int>;  // (operator type, max_nprim, max_l, deriv_order)
+
+public:
+    /**
+     *  A libint2::Engine that is checked out of an EnginePool, and is returned to it upon destruction
+     */
+    class Lease {
+    private:
+        GQCG::EnginePool* pool;  // the pool that the engine is returned to
+        Key key;
+        std::unique_ptr<libint2::Engine> engine;
+
+    public:
+        // CONSTRUCTORS
+        /**
+         *  Constructor based on the @param pool that the @param engine with the given @param key was checked out of
+         */
+        Lease(GQCG::EnginePool* pool, const Key& key, std::unique_ptr<libint2::Engine> engine);
+
+        Lease(const Lease& other) = delete;
+        Lease(Lease&& other) = default;
+
+
+        // DESTRUCTOR
+        /**
+         *  Return the engine to the pool
+         */
+        ~Lease();
+
+
+        // OPERATORS
+        Lease& operator=(const Lease& other) = delete;
+        Lease& operator=(Lease&& other) = delete;
+
+        libint2::Engine& operator*() const { return *this->engine; }
+        libint2::Engine* operator->() const { return this->engine.get(); }
+    };
+
+
+private:
+    std::mutex mutex;  // protects the idle engines
+    std::map<Key, std::vector<std::unique_ptr<libint2::Engine>>> idle_engines;
+
+
+    /**
+     *  Return the given @param engine with the given @param key to the pool
+     */
+    void checkin(const Key& key, std::unique_ptr<libint2::Engine> engine);
+
+public:
+    // PUBLIC METHODS
+    /**
+     *  @return a lease on an engine for the given @param operator_type, @param max_nprim, @param max_l and @param deriv_order
+     *
+     *  An idle engine is reused if there is one, otherwise a new engine is constructed (outside of the lock)
+     */
+    Lease checkout(libint2::Operator operator_type, size_t max_nprim, int max_l, int deriv_order=0);
+
+    /**
+     *  @return the number of engines that are currently idle in the pool
+     */
+    size_t numberOfIdleEngines();
+
+    /**
+     *  Destroy all the idle engines
+     */
+    void clear();
+};
+
+
+}  // namespace GQCG
+
+
+#endif  // GQCG_ENGINEPOOL_HPP
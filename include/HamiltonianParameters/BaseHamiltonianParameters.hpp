@@ -21,12 +21,20 @@ public:
      */
     explicit BaseHamiltonianParameters(AOBasis_sptr ao_basis_sptr);
 
+    BaseHamiltonianParameters(const BaseHamiltonianParameters& other) = default;
+    BaseHamiltonianParameters(BaseHamiltonianParameters&& other) = default;
+
 
     // DESTRUCTOR
     /**
      *  Provide a pure virtual destructor to make the class abstract
      */
     virtual ~BaseHamiltonianParameters() = 0;
+
+
+    // OPERATORS
+    BaseHamiltonianParameters& operator=(const BaseHamiltonianParameters& other) = default;
+    BaseHamiltonianParameters& operator=(BaseHamiltonianParameters&& other) = default;
 };
 
 
@@ -2,6 +2,9 @@
 #define GQCG_HAMILTONIANPARAMETERS_HPP
 
 
+#include <functional>
+#include <vector>
+
 #include "Eigen/Dense"
 
 #include "HamiltonianParameters/BaseHamiltonianParameters.hpp"
@@ -18,25 +21,77 @@ private:
     OneElectronOperator S;  // overlap
 
     OneElectronOperator h;  // one-electron interactions (i.e. the core Hamiltonian)
-    TwoElectronOperator g;  // two-electron interactions
+    mutable TwoElectronOperator g;  // two-electron interactions (mutable, so that a pending transformation can be applied upon access)
 
     Eigen::MatrixXd C;  // total transformation matrix between the current (restricted) molecular orbitals and the atomic orbitals
+    double core_energy;  // a scalar energy contribution, e.g. of the frozen (doubly occupied) core orbitals of an active space
+
+    bool lazy;  // if the transformation of the two-electron operator is deferred until it is accessed
+    mutable Eigen::MatrixXd pending_transformation;  // the composed transformations that haven't been applied to g yet (empty if there are none)
+
+
+    // PRIVATE METHODS
+    /**
+     *  Transform the two-electron operator with the transformation matrix @param T, or compose @param T with the
+     *  pending transformation in the lazy mode
+     */
+    void transformTwoElectronOperator(const Eigen::MatrixXd& T);
+
+    /**
+     *  Apply the pending transformation (if any) to the two-electron operator
+     */
+    void applyPendingTransformation() const;
 
 
 public:
     // CONSTRUCTORS
     /**
      *  Constructor based on a given @param ao_basis_sptr, overlap @param S, one-electron operator @param h, two-electron
-     *  operator @param g and a transformation matrix between the current molecular orbitals and the atomic orbitals
-     *  @param C
+     *  operator @param g, a transformation matrix between the current molecular orbitals and the atomic orbitals
+     *  @param C and a scalar @param core_energy
+     *
+     *  There can be less molecular orbitals (i.e. columns of @param C) than atomic orbitals, e.g. for an active space
+     *
+     *  The arguments are moved from if they are given as an rvalue, so that the operators aren't copied
      */
-    HamiltonianParameters(AOBasis_sptr ao_basis_sptr, const GQCG::OneElectronOperator& S, const GQCG::OneElectronOperator& h, const GQCG::TwoElectronOperator& g, const Eigen::MatrixXd& C);
+    HamiltonianParameters(AOBasis_sptr ao_basis_sptr, GQCG::OneElectronOperator S, GQCG::OneElectronOperator h, GQCG::TwoElectronOperator g, Eigen::MatrixXd C, double core_energy=0.0);
+
+    HamiltonianParameters(const HamiltonianParameters& other) = default;
+    HamiltonianParameters(HamiltonianParameters&& other) = default;
 
 
     // DESTRUCTORS
     ~HamiltonianParameters() override =default;
 
 
+    // OPERATORS
+    HamiltonianParameters& operator=(const HamiltonianParameters& other) = default;
+    HamiltonianParameters& operator=(HamiltonianParameters&& other) = default;
+
+
+    // GETTERS
+    const GQCG::OneElectronOperator& get_S() const { return this->S; }
+    const GQCG::OneElectronOperator& get_h() const { return this->h; }
+    const GQCG::TwoElectronOperator& get_g() const { this->applyPendingTransformation(); return this->g; }  // in the lazy mode, the pending transformation is applied first
+    const Eigen::MatrixXd& get_C() const { return this->C; }
+    double get_core_energy() const { return this->core_energy; }
+    bool get_lazy() const { return this->lazy; }
+
+
+    // SETTERS
+    /**
+     *  Turn the lazy mode on or off, according to @param lazy
+     *
+     *  In the lazy mode, transformations and rotations are applied immediately to S, h and C (which is O(K^3)), but the
+     *  two-electron operator g is only transformed (once, with all the composed transformations) when it is accessed
+     *  through get_g(). Turning the lazy mode off applies the pending transformation
+     *
+     *  Note that, in the lazy mode, get_g() modifies the (mutable) two-electron operator, so that concurrent calls on the
+     *  same HamiltonianParameters aren't thread-safe
+     */
+    void set_lazy(bool lazy);
+
+
     // PUBLIC METHODS
     /**
      *  Given a transformation matrix @param T that links the new molecular orbital basis to the old molecular orbital basis,
@@ -76,11 +131,42 @@ public:
      */
     void rotate(const GQCG::JacobiRotationParameters& jacobi_rotation_parameters);
 
+    /**
+     *  Apply the sequence of Jacobi rotations given by @param jacobi_rotation_parameters (in that order), which gives the
+     *  same result as rotating with every one of them separately
+     *
+     *  For a long sequence, the Jacobi rotations are first accumulated in one unitary rotation matrix U = J_1 J_2 ... J_n,
+     *  so that the operators are only transformed once instead of once per Jacobi rotation
+     */
+    void rotate(const std::vector<GQCG::JacobiRotationParameters>& jacobi_rotation_parameters);
+
+    /**
+     *  @return the HamiltonianParameters in the active space of the given @param active_orbitals, in which the given
+     *  @param inactive_orbitals are frozen (i.e. doubly occupied)
+     *
+     *  For orthonormal molecular orbitals, with i, j inactive and t, u, v, w active orbitals, the active-space
+     *  HamiltonianParameters have
+     *      - the effective one-electron operator h_tu + sum_i (2 (tu|ii) - (ti|iu)), in which the interaction with the
+     *        core electrons is folded in
+     *      - the active block (tu|vw) of the two-electron operator, in the same storage
+     *      - the core energy sum_i 2 h_ii + sum_ij (2 (ii|jj) - (ij|ji)), which is added to the current core energy
+     *      - the active block of S and the active columns of C
+     *
+     *  Only the elements of the selected orbitals are used, and this isn't modified. In the lazy mode, only the columns
+     *  of the pending transformation that belong to the n selected orbitals are applied, with TwoElectronOperator::transformed():
+     *  g isn't copied, and the transformed operator has dimension n (the intermediates of the dense storage have n K^3 elements)
+     */
+    HamiltonianParameters reduceToActiveSpace(const std::vector<size_t>& inactive_orbitals, const std::vector<size_t>& active_orbitals) const;
+
 
     // FRIEND CLASSES
     friend class RestrictedHamiltonianBuilder;
     friend class DOCI;
     friend class FCI;
+
+
+    // FRIEND FUNCTIONS
+    friend void visitMolecularHamiltonianParameters(AOBasis_sptr ao_basis_sptr, const std::vector<std::vector<GQCG::Atom>>& trajectory, const std::function<void (size_t frame, const HamiltonianParameters& ham_par)>& visitor, GQCG::TwoElectronStorage storage);  // reuses the two-electron operator across frames
 };
 
 typedef std::shared_ptr<GQCG::HamiltonianParameters> HamiltonianParameters_sptr;
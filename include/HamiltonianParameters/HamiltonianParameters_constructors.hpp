@@ -3,7 +3,9 @@
 
 
 
+#include <functional>
 #include <memory>
+#include <vector>
 
 #include "AOBasis.hpp"
 #include "HamiltonianParameters.hpp"
@@ -13,6 +15,13 @@
 namespace GQCG {
 
 
+/**
+ *  A visitor that is called for every frame of a trajectory, with the index of the @param frame and the corresponding
+ *  @param ham_par
+ */
+using HamiltonianParametersVisitor = std::function<void (size_t frame, const GQCG::HamiltonianParameters& ham_par)>;
+
+
 /**
  *  @return HamiltonianParameters corresponding to the molecular Hamiltonian for the given @param ao_basis_sptr
  *
@@ -22,8 +31,51 @@ namespace GQCG {
  *          - nuclear attraction
  *      - two-electron contributions:
  *          - Coulomb repulsion
+ *
+ *  The two-electron integrals are stored in the given @param storage
+ */
+GQCG::HamiltonianParameters constructMolecularHamiltonianParameters(AOBasis_sptr ao_basis_sptr, GQCG::TwoElectronStorage storage=GQCG::TwoElectronStorage::dense);
+
+/**
+ *  @return HamiltonianParameters corresponding to the molecular Hamiltonian for the given @param ao_basis_sptr, in which
+ *  the two-electron integrals are represented by a pivoted Cholesky decomposition with the given @param cholesky_tolerance
+ *
+ *  The molecular Hamiltonian has
+ *      - one-electron contributions:
+ *          - kinetic
+ *          - nuclear attraction
+ *      - two-electron contributions:
+ *          - Coulomb repulsion
+ */
+GQCG::HamiltonianParameters constructCholeskyMolecularHamiltonianParameters(AOBasis_sptr ao_basis_sptr, double cholesky_tolerance);
+
+/**
+ *  @return HamiltonianParameters corresponding to the molecular Hamiltonian for the given @param ao_basis_sptr, in which
+ *  the two-electron integrals are density-fitted in the given @param auxiliary_basis_sptr
+ *
+ *  The molecular Hamiltonian has
+ *      - one-electron contributions:
+ *          - kinetic
+ *          - nuclear attraction
+ *      - two-electron contributions:
+ *          - Coulomb repulsion
+ */
+GQCG::HamiltonianParameters constructDensityFittedMolecularHamiltonianParameters(AOBasis_sptr ao_basis_sptr, AOBasis_sptr auxiliary_basis_sptr);
+
+/**
+ *  Call the given @param visitor with the molecular HamiltonianParameters for every frame in the given @param trajectory,
+ *  in which every frame contains the atoms of @param ao_basis_sptr at other positions
+ *
+ *  Instead of constructing a new AOBasis for every frame, the shells of a copy of the given AOBasis are recentered, so
+ *  that the basis set is only read once (the given AOBasis itself is never modified), and the libint2::Engines are
+ *  reused from the engine pool. The two-electron integrals are stored in the given @param storage: in the dense and
+ *  packed storage, they are recalculated in the memory of the previous frame, so that no new K^4 object is allocated
+ *  for every frame
+ *
+ *  Note that the HamiltonianParameters only exist during the call to the visitor, so they should be copied if they
+ *  are needed afterwards
  */
-GQCG::HamiltonianParameters constructMolecularHamiltonianParameters(AOBasis_sptr ao_basis_sptr);
+void visitMolecularHamiltonianParameters(AOBasis_sptr ao_basis_sptr, const std::vector<std::vector<GQCG::Atom>>& trajectory, const GQCG::HamiltonianParametersVisitor& visitor, GQCG::TwoElectronStorage storage=GQCG::TwoElectronStorage::dense);
 
 
 
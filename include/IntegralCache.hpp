@@ -0,0 +1,175 @@
+#ifndef GQCG_INTEGRALCACHE_HPP
+#define GQCG_INTEGRALCACHE_HPP
+
+
+#include "AOBasis.hpp"
+#include "Operator/TwoElectronOperator.hpp"
+
+#include <cstdint>
+#include <string>
+
+
+namespace GQCG {
+
+
+/**
+ *  A read-only memory mapping of the symmetry-unique two-electron integrals in a cache file
+ *
+ *  The integrals are accessed in the mapped pages of the file, without copying them into memory of this process, so
+ *  every process that maps the same cache file shares the same pages in the page cache. The file is unmapped when the
+ *  mapping is destroyed
+ */
+class MappedTwoElectronIntegrals {
+private:
+    void* address;  // the start of the mapping, i.e. of the header of the cache file
+    size_t length;  // the length of the mapping in bytes
+    size_t dim;  // the dimension of the orbital basis
+    const double* packed_elements;  // the symmetry-unique elements in the mapping, addressed by TwoElectronOperator::packedIndex()
+
+public:
+    // CONSTRUCTORS
+    /**
+     *  Constructor based on a mapping of @param length bytes at the given @param address, in which the symmetry-unique
+     *  two-electron integrals in an orbital basis of dimension @param K start at the given @param offset
+     */
+    MappedTwoElectronIntegrals(void* address, size_t length, size_t K, size_t offset);
+
+    MappedTwoElectronIntegrals(const MappedTwoElectronIntegrals& other) = delete;
+    MappedTwoElectronIntegrals(MappedTwoElectronIntegrals&& other) noexcept;
+
+
+    // DESTRUCTORS
+    ~MappedTwoElectronIntegrals();
+
+
+    // OPERATORS
+    MappedTwoElectronIntegrals& operator=(const MappedTwoElectronIntegrals& other) = delete;
+    MappedTwoElectronIntegrals& operator=(MappedTwoElectronIntegrals&& other) = delete;
+
+    /**
+     *  @return the two-electron integral (pq|rs) for the given indices @param p, @param q, @param r and @param s
+     */
+    double operator()(size_t p, size_t q, size_t r, size_t s) const { return this->packed_elements[GQCG::TwoElectronOperator::packedIndex(p, q, r, s)]; }
+
+
+    // GETTERS
+    size_t get_dim() const { return this->dim; }
+
+    /**
+     *  @return the symmetry-unique elements (addressed by TwoElectronOperator::packedIndex()) as a read-only view on the
+     *  mapping, without a copy
+     */
+    Eigen::Map<const Eigen::VectorXd> get_packed_elements() const { return Eigen::Map<const Eigen::VectorXd>(this->packed_elements, GQCG::TwoElectronOperator::numberOfPackedElements(this->dim)); }
+};
+
+
+/**
+ *  A persistent cache for the two-electron integrals calculated by the LibintCommunicator
+ *
+ *  The symmetry-unique integrals are stored in a versioned binary file in @member directory, whose name contains a
+ *  fingerprint of the shells of the basis, the Schwarz threshold and the accuracy. Integrals that are already present on
+ *  disk aren't calculated by libint again, so repeated jobs can share them:
+ *      - map() gives a read-only memory mapping of the file, which is shared between processes and isn't copied
+ *      - calculateTwoElectronIntegrals() reads the file directly into the packed elements of a TwoElectronOperator,
+ *        since a TwoElectronOperator owns (and can transform) its matrix representation
+ *
+ *  Files are written to a temporary name first and then renamed, so that another process (or thread) never sees a
+ *  partially written file. If a file can't be written (e.g. on a read-only or full disk), the integrals are still
+ *  returned, but they aren't cached
+ */
+class IntegralCache {
+private:
+    static constexpr uint32_t version = 1;  // the version of the file format: files with another version are recalculated
+
+    const std::string directory;  // the directory in which the cache files are stored
+
+
+    /**
+     *  The header at the start of every cache file, directly followed by the packed two-electron integrals
+     */
+    struct Header {
+        char magic[8];  // "GQCGERI"
+        uint32_t version;
+        uint32_t reserved;
+        uint64_t fingerprint;  // the fingerprint of the AOBasis
+        uint64_t number_of_basis_functions;
+        uint64_t number_of_elements;  // the number of packed two-electron integrals following the header
+    };
+
+
+    /**
+     *  @return a file descriptor for the cache file of the given @param ao_basis, positioned directly after its header,
+     *  or -1 if there is no valid cache file
+     */
+    int openCacheFile(const GQCG::AOBasis& ao_basis) const;
+
+    /**
+     *  @return the packed two-electron integrals that are stored in the cache for the given @param ao_basis, or an empty
+     *  vector if there is no valid cache file
+     */
+    Eigen::VectorXd load(const GQCG::AOBasis& ao_basis) const;
+
+    /**
+     *  Store the given @param packed_elements as the two-electron integrals for the given @param ao_basis
+     *
+     *  @return if the cache file could be written
+     */
+    bool store(const GQCG::AOBasis& ao_basis, const Eigen::VectorXd& packed_elements) const;
+
+public:
+    // CONSTRUCTORS
+    /**
+     *  Constructor based on the @param directory in which the cache files are stored
+     */
+    explicit IntegralCache(const std::string& directory);
+
+
+    // GETTERS
+    const std::string& get_directory() const { return this->directory; }
+
+
+    // STATIC PUBLIC METHODS
+    /**
+     *  @return a fingerprint of the given @param ao_basis, based on its shells (i.e. their exponents, contractions and
+     *  centers) and the current Schwarz threshold and accuracy of the LibintCommunicator
+     *
+     *  Since the shells are hashed instead of the basis set name, names that give the same basis (e.g. "STO-3G" and
+     *  "sto-3g") share their cache file. The fingerprint is calculated with the 64-bit FNV-1a hash, so it doesn't change
+     *  between processes or platforms
+     */
+    static uint64_t fingerprint(const GQCG::AOBasis& ao_basis);
+
+
+    // PUBLIC METHODS
+    /**
+     *  @return the name of the cache file for the given @param ao_basis
+     */
+    std::string filename(const GQCG::AOBasis& ao_basis) const;
+
+    /**
+     *  @return if there is a valid cache file for the given @param ao_basis, which only requires reading its header
+     */
+    bool contains(const GQCG::AOBasis& ao_basis) const;
+
+    /**
+     *  @return the Coulomb two-electron integrals in the given @param ao_basis, in the given @param storage
+     *
+     *  If they are present in the cache, they are read from the cache file. Otherwise, they are calculated by the
+     *  LibintCommunicator and stored in the cache
+     */
+    GQCG::TwoElectronOperator calculateTwoElectronIntegrals(const GQCG::AOBasis& ao_basis, GQCG::TwoElectronStorage storage=GQCG::TwoElectronStorage::dense) const;
+
+    /**
+     *  @return a read-only memory mapping of the Coulomb two-electron integrals in the given @param ao_basis
+     *
+     *  If they aren't present in the cache yet, they are calculated by the LibintCommunicator and stored in the cache
+     *  first. Throws if the cache file can't be written or mapped
+     */
+    GQCG::MappedTwoElectronIntegrals map(const GQCG::AOBasis& ao_basis) const;
+};
+
+
+}  // namespace GQCG
+
+
+#endif  // GQCG_INTEGRALCACHE_HPP
@@ -32,6 +32,12 @@ public:
     JacobiRotationParameters(size_t p, size_t q, double angle);
 
 
+    // GETTERS
+    size_t get_p() const { return this->p; }
+    size_t get_q() const { return this->q; }
+    double get_angle() const { return this->angle; }
+
+
     // FRIEND CLASSES
     friend class OneElectronOperator;
 
@@ -3,10 +3,17 @@
 
 
 #include "AOBasis.hpp"
+#include "EnginePool.hpp"
 #include "Molecule.hpp"
 #include "Operator/OneElectronOperator.hpp"
 #include "Operator/TwoElectronOperator.hpp"
 
+#include <array>
+#include <atomic>
+#include <functional>
+#include <utility>
+#include <vector>
+
 #include <Eigen/Dense>
 #include <unsupported/Eigen/CXX11/Tensor>
 #include <libint2.hpp>
@@ -16,12 +23,68 @@ namespace GQCG {
 
 
 /**
- *  A singleton class that takes care of interfacing with the Libint2 (version >2.2.0) C++ API
+ *  A block of calculated two-electron integrals (ab|cd) over the shells a, b, c and d
+ *
+ *  Note that:
+ *      - only canonical shell quartets (a >= b, c >= d, ab >= cd, in an internal shell order) are visited, but a
+ *        block contains all the integrals between the basis functions of its shells: when a == b (or c == d, or
+ *        ab == cd), symmetry-equivalent integrals appear more than once inside the block
+ *      - @member integrals points to memory owned by a libint2::Engine: it is only valid during the visit
+ */
+struct ShellQuartetBlock {
+    std::array<size_t, 4> shells;  // the indices of the shells a, b, c and d
+    std::array<size_t, 4> first_bf;  // the index of the first basis function of every shell
+    std::array<size_t, 4> nbf;  // the number of basis functions in every shell
+    const double* integrals;  // the integrals, packed in row-major form
+
+
+    /**
+     *  @return the integral between the basis functions @param f1, @param f2, @param f3 and @param f4, given as indices
+     *  relative to the first basis function of their shell
+     */
+    double operator()(size_t f1, size_t f2, size_t f3, size_t f4) const {
+        return this->integrals[f4 + this->nbf[3] * (f3 + this->nbf[2] * (f2 + this->nbf[1] * f1))];
+    }
+
+    /**
+     *  @return the number of shell quartets that are equivalent to this one through the 8-fold permutational symmetry
+     *
+     *  Summing every integral in the block, multiplied by this degeneracy, over all the visited blocks, is equivalent to
+     *  summing the symmetrized integrals over all shell quartets
+     */
+    double degeneracy() const {
+        double degeneracy_12 = (this->shells[0] == this->shells[1]) ? 1.0 : 2.0;
+        double degeneracy_34 = (this->shells[2] == this->shells[3]) ? 1.0 : 2.0;
+        double degeneracy_12_34 = ((this->shells[0] == this->shells[2]) && (this->shells[1] == this->shells[3])) ? 1.0 : 2.0;
+
+        return degeneracy_12 * degeneracy_34 * degeneracy_12_34;
+    }
+};
+
+
+/**
+ *  A visitor that is called for every calculated shell quartet, with the calculated @param block and the index of the
+ *  @param thread that calculated it
+ */
+using ShellQuartetVisitor = std::function<void (const GQCG::ShellQuartetBlock& block, size_t thread)>;
+
+
+/**
+ *  A singleton class that takes care of interfacing with the Libint2 (version >=2.6.0) C++ API
  *
  *  Singleton class template from (https://stackoverflow.com/a/1008289)
  */
 class LibintCommunicator {
 private:
+    size_t number_of_threads;  // the number of threads that are used to calculate integrals
+    double schwarz_threshold;  // shell quartets whose Schwarz bound is smaller than this threshold are not calculated
+    double accuracy;  // the target accuracy of the integrals, which is used as the precision of every libint2::Engine
+
+    mutable std::atomic<size_t> number_of_screened_quartets;  // the number of shell quartets that were skipped in the last two-electron integral calculation
+
+    mutable GQCG::EnginePool engine_pool;  // the libint2::Engines that can be reused by all the integral calculations
+
+
     /**
      *  Private constructor as required by the singleton class design
      */
@@ -32,6 +95,39 @@ private:
      */
     ~LibintCommunicator();
 
+    /**
+     *  Execute the given @param task on @member number_of_threads threads and wait for all of them to finish
+     *
+     *  The task is called with the index of the thread that executes it, so that it can use thread-local resources (e.g. its own libint2::Engine)
+     *  If one of the threads throws, the first exception is re-thrown on the calling thread
+     */
+    void parallelize(const std::function<void (size_t)>& task) const;
+
+    /**
+     *  @return the number of components (i.e. matrices) that libint2 calculates for the given @param operator_type
+     */
+    static size_t numberOfComponents(libint2::Operator operator_type);
+
+    /**
+     *  @return the indices of the shells in the given @param basisset, sorted by their (l, nprim) class
+     *
+     *  The integral loops visit the shells in this order, so that consecutive shell sets belong to the same class
+     */
+    static std::vector<size_t> sortedShellOrder(const libint2::BasisSet& basisset);
+
+    /**
+     *  @return the indices (i1, i2), with i1 >= i2, that correspond to the compound pair index @param i12 = i1 (i1 + 1) / 2 + i2
+     *
+     *  The indices are found in closed form, instead of with a scan over i1
+     */
+    static std::pair<size_t, size_t> unpairIndex(size_t i12);
+
+    /**
+     *  @return an estimate for the overlap of the given shells @param shell1 and @param shell2: the largest Gaussian product
+     *  prefactor exp(-a b / (a + b) |A - B|^2) over their primitives
+     */
+    static double estimatePrimitiveOverlap(const libint2::Shell& shell1, const libint2::Shell& shell2);
+
 public:
     /**
      *  @return the static singleton instance
@@ -46,24 +142,182 @@ public:
     void operator=(LibintCommunicator const& libint_communicator) = delete;
 
 
+    // GETTERS
+    size_t get_number_of_threads() const { return this->number_of_threads; }
+    double get_schwarz_threshold() const { return this->schwarz_threshold; }
+    double get_accuracy() const { return this->accuracy; }
+    size_t get_number_of_screened_quartets() const { return this->number_of_screened_quartets; }
+    size_t get_number_of_idle_engines() const { return this->engine_pool.numberOfIdleEngines(); }
+
+
+    // SETTERS
+    /**
+     *  Set the number of threads that are used to calculate integrals to @param number_of_threads
+     *
+     *  Every thread checks out its own libint2::Engine and the shell pairs are handed out dynamically. The
+     *  calculated integrals do not depend on the number of threads.
+     */
+    void set_number_of_threads(size_t number_of_threads);
+
+    /**
+     *  Set the threshold for the Cauchy-Schwarz screening of the two-electron integrals to @param schwarz_threshold
+     *
+     *  A shell quartet (ab|cd) is not calculated if its Schwarz bound sqrt(max|(ab|ab)|) * sqrt(max|(cd|cd)|) is smaller
+     *  than the threshold, so every skipped integral is smaller than the threshold in absolute value. A threshold of 0.0
+     *  (the default) disables the screening.
+     */
+    void set_schwarz_threshold(double schwarz_threshold);
+
+    /**
+     *  Set the target accuracy of the integrals to @param accuracy, which drives all the screening together:
+     *      - it is used as the precision of every libint2::Engine, with which libint screens the primitive pairs and
+     *        primitive quartets whose contributions are negligible
+     *      - it is used as the Schwarz threshold, so that every skipped shell quartet only contains integrals that are
+     *        smaller than the accuracy
+     *
+     *  Every (one- and two-electron) integral then has an absolute error of about the accuracy at most. The default
+     *  accuracy is the machine epsilon (i.e. libint's default precision), with the Schwarz screening disabled
+     */
+    void set_accuracy(double accuracy);
+
+
     // PUBLIC METHODS
+    /**
+     *  @return a lease on a (possibly reused) libint2::Engine for the given @param operator_type, @param max_nprim,
+     *  @param max_l and @param deriv_order, that is returned to the engine pool when it goes out of scope
+     *
+     *  The precision of the engine is set to @member accuracy
+     *
+     *  The engine pool is thread-safe, so the integral calculations can be called concurrently from different threads
+     *  (as long as the settings of the LibintCommunicator aren't changed at the same time)
+     */
+    GQCG::EnginePool::Lease checkoutEngine(libint2::Operator operator_type, size_t max_nprim, int max_l, int deriv_order=0) const;
+
     /**
      *  @return a std::vector<libint2::Atom> based on a given std::vector<GQCG::Atom> @param atoms
      */
     std::vector<libint2::Atom> interface(const std::vector<GQCG::Atom>& atoms) const;
 
 
+    /**
+     *  @return the Schwarz bounds sqrt(max|(ab|ab)|) for every pair of shells a and b in the given @param basisset, where
+     *  the maximum is taken over all the basis functions in the shells
+     */
+    Eigen::MatrixXd calculateSchwarzBounds(const libint2::BasisSet& basisset) const;
+
     /**
      *  @return the OneElectronOperator corresponding to the matrix representation of @param operator_type in the given
      *  @param ao_basis. The corresponding @param molecule is also given as an argument, to be able to access
      */
     GQCG::OneElectronOperator calculateOneElectronIntegrals(libint2::Operator operator_type, const GQCG::AOBasis& ao_basis) const;
 
+    /**
+     *  @return the OneElectronOperators corresponding to the matrix representations of all the given @param operator_types
+     *  in the given @param ao_basis
+     *
+     *  All the operators are calculated in one pass over the unique shell pairs, whose integrals are mirrored to the other
+     *  triangle. Operators with more than one component (e.g. libint2::Operator::emultipole1) give all their components,
+     *  in the order libint2 calculates them
+     *
+     *  The operators are returned in the given @param storage. Shell pairs whose primitive overlap estimate is smaller than
+     *  the given @param overlap_threshold are skipped, which is mostly useful for the sparse storage of large molecules
+     */
+    std::vector<GQCG::OneElectronOperator> calculateOneElectronIntegrals(const std::vector<libint2::Operator>& operator_types, const GQCG::AOBasis& ao_basis, GQCG::OneElectronStorage storage=GQCG::OneElectronStorage::dense, double overlap_threshold=0.0) const;
+
+    /**
+     *  Calculate the two-electron integrals of @param operator_type in the given @param ao_basis, and call the given
+     *  @param visitor for every calculated (canonical) shell quartet, so that the integrals can be contracted on the fly
+     *  without allocating the full tensor
+     *
+     *  For the Coulomb operator, shell quartets whose Schwarz bound is smaller than @member schwarz_threshold are skipped:
+     *  the Schwarz bounds of the AOBasis are Coulomb integrals, so other operators are never screened. The shell quartets are
+     *  calculated on @member number_of_threads threads and the visitor is called on the thread that calculated the
+     *  block: it should therefore not write to shared memory without synchronization (e.g. by using a separate
+     *  accumulator for every thread index)
+     *
+     *  If the integrals are contracted with a density, the (shell pair) @param density_bounds max|D_ab| can be given:
+     *  a shell quartet (ab|cd) is then skipped if its Schwarz bound, multiplied by the largest of the density bounds of
+     *  the pairs ab, cd, ac, ad, bc and bd, is smaller than the largest of @member schwarz_threshold and @member accuracy.
+     *  These contractions are therefore always screened, also with the default settings: a skipped shell quartet only
+     *  changes the contracted result by less than the target accuracy per element of the density
+     */
+    void visitTwoElectronIntegrals(libint2::Operator operator_type, const GQCG::AOBasis& ao_basis, const GQCG::ShellQuartetVisitor& visitor, const Eigen::MatrixXd& density_bounds=Eigen::MatrixXd()) const;
+
     /**
      *  @return the TwoElectronOperator corresponding to the matrix representation of @param operator_type in the given
-     *  @param ao_basis
+     *  @param ao_basis, in the given @param storage
+     *
+     *  For the packed storage, the integrals are written directly to the symmetry-unique elements, so the dense tensor is never formed
+     *  For the mixed storage, the packed integrals are compressed with TwoElectronOperator::default_error_bound
+     *
+     *  Shell quartets whose Schwarz bound is smaller than @member schwarz_threshold are skipped: their number can be
+     *  retrieved afterwards with get_number_of_screened_quartets()
+     */
+    GQCG::TwoElectronOperator calculateTwoElectronIntegrals(libint2::Operator operator_type, const GQCG::AOBasis& ao_basis, GQCG::TwoElectronStorage storage=GQCG::TwoElectronStorage::dense) const;
+
+    /**
+     *  Recalculate the matrix representation of @param operator_type in the given @param ao_basis into the given
+     *  two-electron operator @param g, in its current (dense or packed) storage
+     *
+     *  The memory of @param g is reused if its dimension is already the number of basis functions, so that no new K^4
+     *  object is allocated, e.g. for every frame of a trajectory
+     */
+    void recalculateTwoElectronIntegrals(libint2::Operator operator_type, const GQCG::AOBasis& ao_basis, GQCG::TwoElectronOperator& g) const;
+
+    /**
+     *  @return the Coulomb matrices J_pq = sum_rs (pq|rs) D_rs (first) and the exchange matrices K_pr = sum_qs (pq|rs) D_qs
+     *  (second) for every one of the given symmetric @param densities in the given @param ao_basis
+     *
+     *  The matrices are accumulated directly from the calculated shell quartets, so the two-electron integrals are never
+     *  stored: the memory requirement is linear in the number of densities. Shell quartets are always screened with both
+     *  their Schwarz bound and the magnitude of the densities, using the largest of @member schwarz_threshold and
+     *  @member accuracy (i.e. get_accuracy() by default)
+     */
+    std::pair<std::vector<GQCG::OneElectronOperator>, std::vector<GQCG::OneElectronOperator>> calculateCoulombAndExchangeMatrices(const std::vector<Eigen::MatrixXd>& densities, const GQCG::AOBasis& ao_basis) const;
+
+    /**
+     *  @return the TwoElectronOperator, in the factorized storage, corresponding to a pivoted Cholesky decomposition of the
+     *  matrix representation of @param operator_type in the given @param ao_basis
+     *
+     *  The Cholesky vectors are added until every diagonal element (pq|pq) is reproduced within the given @param tolerance,
+     *  which also bounds the error on every element: |(pq|rs) - sum_L L^L_pq L^L_rs| <= @param tolerance
+     *
+     *  The integrals are calculated in columns of shell pairs, so that the full tensor is never formed: the memory
+     *  requirement is O(K^2 M), with M the number of Cholesky vectors
+     */
+    GQCG::TwoElectronOperator calculateCholeskyDecomposedTwoElectronIntegrals(libint2::Operator operator_type, const GQCG::AOBasis& ao_basis, double tolerance) const;
+
+    /**
+     *  @return the TwoElectronOperator, in the factorized storage, corresponding to the density-fitted (resolution of the
+     *  identity) Coulomb integrals in the given @param ao_basis, using the given @param auxiliary_basis
+     *
+     *  The factors are the fitted three-center integrals
+     *      B^P_pq = sum_Q (P|Q)^(-1/2) (Q|pq) ,
+     *  such that (pq|rs) ~ sum_P B^P_pq B^P_rs. Only the three-center integrals (P|pq) and the two-center integrals (P|Q)
+     *  are calculated, so the memory requirement is O(K^2 * naux)
+     */
+    GQCG::TwoElectronOperator calculateDensityFittedIntegrals(const GQCG::AOBasis& ao_basis, const GQCG::AOBasis& auxiliary_basis) const;
+
+    /**
+     *  @return the first derivatives of the matrix representation of @param operator_type (overlap, kinetic or nuclear)
+     *  in the given @param ao_basis with respect to the nuclear coordinates: the derivative with respect to coordinate
+     *  x (0, 1 or 2) of atom A is found at index 3 * A + x
+     *
+     *  The derivatives of the basis functions on atom A and, for the nuclear attraction integrals, the derivative of the
+     *  operator itself (through the point charge of atom A) are summed, so that every derivative is symmetric
+     */
+    std::vector<GQCG::OneElectronOperator> calculateOneElectronIntegralDerivatives(libint2::Operator operator_type, const GQCG::AOBasis& ao_basis) const;
+
+    /**
+     *  @return the first derivatives of the matrix representation of @param operator_type (coulomb) in the given
+     *  @param ao_basis with respect to the nuclear coordinates, in the given @param storage (dense or packed): the
+     *  derivative with respect to coordinate x (0, 1 or 2) of atom A is found at index 3 * A + x
+     *
+     *  Every derivative keeps the 8-fold permutational symmetry, so only the canonical shell quartets are calculated,
+     *  in one pass for all the nuclear coordinates. Note that the Schwarz screening doesn't apply to derivative integrals,
+     *  so no shell quartets are skipped
      */
-    GQCG::TwoElectronOperator calculateTwoElectronIntegrals(libint2::Operator operator_type, const GQCG::AOBasis& ao_basis) const;
+    std::vector<GQCG::TwoElectronOperator> calculateTwoElectronIntegralDerivatives(libint2::Operator operator_type, const GQCG::AOBasis& ao_basis, GQCG::TwoElectronStorage storage=GQCG::TwoElectronStorage::dense) const;
 };
 
 
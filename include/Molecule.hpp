@@ -2,6 +2,7 @@
 #define GQCG_MOLECULE_HPP
 
 
+#include <cstdint>
 #include <stdlib.h>
 #include <string>
 #include <vector>
@@ -18,6 +19,7 @@ class Molecule {
 private:
     const std::vector<GQCG::Atom> atoms;
     const size_t N;  // number of electrons
+    const std::vector<GQCG::Atom> sorted_atoms;  // the atoms sorted with GQCG::Atom::operator<, so that comparisons don't have to sort them again
 
     /**
      *  Parse a @param xyz_filename to @return a std::vector<GQCG::Atom>.
@@ -26,6 +28,11 @@ private:
      */
     static std::vector<GQCG::Atom> parseXYZFile(const std::string& xyz_filename);
 
+    /**
+     *  @return the given @param atoms, sorted with GQCG::Atom::operator<
+     */
+    static std::vector<GQCG::Atom> sortAtoms(std::vector<GQCG::Atom> atoms);
+
 
 public:
     // CONSTRUCTORS
@@ -87,9 +94,26 @@ public:
     // PUBLIC METHODS
     /**
      *  @return if this is equal to @param other, within the given @param tolerance for the coordinates of the atoms
+     *
+     *  Since the atoms are sorted upon construction, this is a linear comparison for the default tolerance
      */
     bool isEqualTo(const GQCG::Molecule& other, double tolerance=GQCG::Atom::tolerance_for_comparison) const;
 
+    /**
+     *  @return a fingerprint of the geometry of this molecule, in which the internuclear distances are rounded to the
+     *  given @param tolerance
+     *
+     *  The fingerprint is built from the number of electrons, the sorted atomic numbers and the sorted internuclear
+     *  distances (labeled by the atomic numbers of both atoms), so it doesn't change if the molecule is translated,
+     *  rotated, reflected or if its atoms are reordered. It is calculated with the 64-bit FNV-1a hash, so it can be used
+     *  as a key to look up results that don't depend on the orientation of the molecule. Note that:
+     *      - molecules with a different fingerprint have a different geometry, but equal fingerprints only make an equal
+     *        geometry very likely
+     *      - a distance that lies on the boundary of two rounding intervals can give different fingerprints for
+     *        geometries that are equal within the @param tolerance
+     */
+    uint64_t fingerprint(double tolerance=GQCG::Atom::tolerance_for_comparison) const;
+
     /**
      *  @return the sum of all the charges of the nuclei
      */
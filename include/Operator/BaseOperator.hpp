@@ -16,7 +16,7 @@ namespace GQCG {
  */
 class BaseOperator {
 protected:
-    const size_t dim;  // dimension of the matrix unsigned_representation of the operator
+    size_t dim;  // dimension of the matrix unsigned_representation of the operator (not const, so that operators can be move-assigned)
 
 
 public:
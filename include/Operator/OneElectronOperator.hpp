@@ -3,6 +3,7 @@
 
 
 #include <Eigen/Dense>
+#include <Eigen/Sparse>
 
 #include "BaseOperator.hpp"
 
@@ -11,42 +12,93 @@ namespace GQCG {
 
 
 
+/**
+ *  The ways in which a OneElectronOperator can store its matrix representation
+ */
+enum class OneElectronStorage {
+    dense,  // the full K x K matrix
+    sparse  // only the (numerically) non-zero elements, e.g. for the overlap and kinetic integrals of large molecules
+};
+
+
 /**
  *  A class that holds the matrix representation of a one-electron operator in an orbital basis
  */
 class OneElectronOperator : public GQCG::BaseOperator {
 private:
-    Eigen::MatrixXd matrix;  // the matrix unsigned_representation of the one-electron operator
+    OneElectronStorage storage;
+
+    Eigen::MatrixXd matrix;  // the matrix unsigned_representation of the one-electron operator (dense storage)
+    Eigen::SparseMatrix<double> sparse_matrix;  // the non-zero elements of the matrix representation (sparse storage)
 
 
 public:
     // CONSTRUCTORS
     /**
-     *  Constructor based on a given @param matrix
+     *  Constructor based on a given @param matrix, which is moved from if it is given as an rvalue
+     */
+    explicit OneElectronOperator(Eigen::MatrixXd matrix);
+
+    /**
+     *  Constructor based on a given @param sparse_matrix, which leads to the sparse storage
      */
-    explicit OneElectronOperator(const Eigen::MatrixXd& matrix);
+    explicit OneElectronOperator(Eigen::SparseMatrix<double> sparse_matrix);
 
 
     // GETTERS
-    Eigen::MatrixXd get_matrix_representation() const { return this->matrix; }
-    double get(size_t index1,size_t index2){ return this->matrix(index1,index2);}
+    /**
+     *  @return the full matrix representation of the one-electron operator, which is expanded for the sparse storage
+     */
+    Eigen::MatrixXd get_matrix_representation() const;
+    double get(size_t index1,size_t index2) const;
+    OneElectronStorage get_storage() const { return this->storage; }
+
+    /**
+     *  @return the dense matrix representation without a copy
+     *
+     *  Throws if the one-electron operator isn't in the dense storage
+     */
+    const Eigen::MatrixXd& get_matrix() const;
+
+    /**
+     *  @return the sparse matrix representation without a copy
+     *
+     *  Throws if the one-electron operator isn't in the sparse storage
+     */
+    const Eigen::SparseMatrix<double>& get_sparse_matrix() const;
     
     
     // OPERATORS
     /**
      *  @return the sum of two OneElectronOperators, i.e. a OneElectronOperator whose matrix representation is the sum
      *  of the two matrix representations of the given OneElectronOperators
+     *
+     *  The sum of two sparse OneElectronOperators is sparse, all other sums are dense
      */
     GQCG::OneElectronOperator operator+(const GQCG::OneElectronOperator& other);
 
 
     // PUBLIC METHODS
+    /**
+     *  Convert the matrix representation to the sparse storage, dropping the elements whose absolute value is not larger
+     *  than the given @param threshold
+     */
+    void sparsify(double threshold=0.0);
+
+    /**
+     *  Convert the matrix representation to the dense storage
+     */
+    void densify();
+
     /**
      *  Transform the matrix representation of a one-electron operator using the transformation matrix @param T
      *
      *  Note that the transformation matrix @param T is used as
      *      b' = b T ,
      *  in which the basis functions are collected as elements of a row vector b
+     *
+     *  In the sparse storage, the product with the sparse matrix is done first. Since a transformed matrix is generally
+     *  dense, the result is stored in the dense storage
      */
     void transform(const Eigen::MatrixXd& T) override;
 
@@ -67,6 +119,7 @@ public:
      *          b' = b U ,
      *        in which the basis functions are collected as elements of a row vector b.
      *      - we use the (cos, sin, -sin, cos) definition for the Jacobi rotation matrix
+     *      - a sparse matrix representation is converted to the dense storage first
      */
     void rotate(const GQCG::JacobiRotationParameters& jacobi_rotation_parameters) override;
 
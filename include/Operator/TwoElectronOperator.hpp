@@ -2,6 +2,12 @@
 #define GQCG_TWOELECTRONOPERATOR_HPP
 
 
+#include <cmath>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Dense>
 #include <unsupported/Eigen/CXX11/Tensor>
 
 #include "BaseOperator.hpp"
@@ -10,37 +16,262 @@
 namespace GQCG {
 
 
+/**
+ *  The ways in which a TwoElectronOperator can store its matrix representation
+ */
+enum class TwoElectronStorage {
+    dense,  // the full K^4 tensor
+    packed,  // only the symmetry-unique elements (pq|rs) with p >= q, r >= s and pq >= rs, i.e. about K^4/8 elements
+    factorized,  // M factors L^L (e.g. Cholesky vectors) such that (pq|rs) = sum_L L^L_pq L^L_rs, i.e. K^2 * M elements
+    mixed  // the symmetry-unique elements in single precision, except for the few large ones, which are kept in double precision
+};
+
+
 /**
  *  A class that holds the matrix representation of a two-electron operator in an orbital basis
+ *
+ *  In the packed storage, the 8-fold permutational symmetry of two-electron integrals over real orbitals
+ *      (pq|rs) = (qp|rs) = (pq|sr) = (qp|sr) = (rs|pq) = (sr|pq) = (rs|qp) = (sr|qp)
+ *  is used to only store the symmetry-unique elements
+ *
+ *  In the factorized storage, the matrix representation is given by
+ *      (pq|rs) = sum_L L^L_pq L^L_rs ,
+ *  in which every factor L^L is a K x K matrix, so that a transformation only requires transforming the factors
+ *
+ *  In the mixed storage, the symmetry-unique elements are stored as floats, which halves the memory footprint of the
+ *  packed storage. Rounding to single precision gives a relative error of at most 2^-24, so every element whose
+ *  absolute value is larger than error_bound * 2^24 is kept in double precision in a (small) correction list. Every
+ *  element then has an absolute error of at most error_bound. Since every correction takes 16 bytes (its packed index and
+ *  its value), the mixed storage is only smaller than the packed one if less than a quarter of the elements needs double
+ *  precision: otherwise (e.g. for small or compact systems with a small error bound), the packed storage is kept.
+ *  Transformations and Jacobi rotations work on the single precision elements and the correction list directly, and
+ *  round every changed element again, so the rounding errors can accumulate over many transformations
  */
 class TwoElectronOperator : public GQCG::BaseOperator {
 private:
-    Eigen::Tensor<double, 4> tensor;  // the matrix unsigned_representation of the two-electron operator
+    TwoElectronStorage storage;
+
+    Eigen::Tensor<double, 4> tensor;  // the matrix unsigned_representation of the two-electron operator (dense storage)
+    Eigen::VectorXd packed_elements;  // the symmetry-unique elements, addressed by packedIndex() (packed storage)
+    Eigen::MatrixXd factors;  // every column is a factor L^L as a column-major K x K matrix, i.e. with row index p + K q (factorized storage)
+
+    double error_bound;  // the absolute error bound on every element (mixed storage)
+    Eigen::VectorXf single_precision_elements;  // the symmetry-unique elements in single precision, addressed by packedIndex() (mixed storage)
+    std::vector<std::pair<size_t, double>> double_precision_elements;  // the (packed index, value) of the large elements, sorted by packed index, whose single precision element is correctedElement() (mixed storage)
+
+
+    // PRIVATE METHODS
+    /**
+     *  Transform the matrix representation of this two-electron operator using the transformation matrix @param T, and
+     *  store the result in @param g_transformed
+     *
+     *  @param g_transformed may be this operator itself, in which case the memory of the untransformed elements is
+     *  released as soon as it isn't needed anymore
+     */
+    void transformInto(const Eigen::MatrixXd& T, TwoElectronOperator& g_transformed) const;
+
+    /**
+     *  Transform the dense matrix representation of a two-electron operator using the transformation matrix @param T,
+     *  and store the result in @param g_transformed (which may be this operator)
+     */
+    void transformDense(const Eigen::MatrixXd& T, TwoElectronOperator& g_transformed) const;
+
+    /**
+     *  Transform the packed matrix representation of a two-electron operator using the transformation matrix @param T,
+     *  and store the result in @param g_transformed (which may be this operator)
+     */
+    void transformPacked(const Eigen::MatrixXd& T, TwoElectronOperator& g_transformed) const;
+
+    /**
+     *  Transform the factorized matrix representation of a two-electron operator using the transformation matrix @param T,
+     *  and store the result in @param g_transformed (which may be this operator)
+     */
+    void transformFactorized(const Eigen::MatrixXd& T, TwoElectronOperator& g_transformed) const;
+
+    /**
+     *  @return the (packed index, value) of the symmetry-unique elements of the packed or mixed matrix representation
+     *  that change under the Jacobi rotation @param jacobi of the orbitals @param p and @param q
+     */
+    std::vector<std::pair<size_t, double>> rotatedElements(size_t p, size_t q, const Eigen::JacobiRotation<double>& jacobi) const;
+
+    /**
+     *  Rotate the packed or mixed matrix representation of a two-electron operator in-place with the Jacobi rotation
+     *  @param jacobi of the orbitals @param p and @param q
+     */
+    void rotatePacked(size_t p, size_t q, const Eigen::JacobiRotation<double>& jacobi);
+
+    /**
+     *  @return the symmetry-unique element with the given @param packed_index of the packed or mixed matrix representation
+     */
+    double packedElement(size_t packed_index) const;
+
+    /**
+     *  @return the symmetry-unique elements of the mixed matrix representation, in double precision
+     */
+    Eigen::VectorXd unmixPackedElements() const;
+
+    /**
+     *  Set the mixed matrix representation to the given @param single_precision_elements and the (packed index, value)
+     *  @param double_precision_elements, which all have an absolute error of at most the given @param error_bound
+     *
+     *  If the mixed storage isn't smaller than the packed storage, the elements are converted to the packed storage
+     */
+    void setMixedElements(Eigen::VectorXf single_precision_elements, std::vector<std::pair<size_t, double>> double_precision_elements, double error_bound);
+
+    /**
+     *  @return if the given @param element should be kept in double precision to have an absolute error of at most the
+     *  given @param error_bound, i.e. if rounding it to the nearest float (with a relative error of at most 2^-24)
+     *  could give a larger error
+     */
+    static bool needsDoublePrecision(double element, double error_bound) { return std::abs(element) * (std::numeric_limits<float>::epsilon() / 2) > error_bound; }
+
+    /**
+     *  @return the single precision element that marks an element of the mixed matrix representation as kept in double
+     *  precision: a NaN, so that it can't be confused with an actual (e.g. zero) element
+     */
+    static float correctedElement() { return std::numeric_limits<float>::quiet_NaN(); }
 
 
 public:
     // GETTERS
-    Eigen::Tensor<double, 4> get_matrix_representation() const { return this->tensor; }
-    double get(size_t index1,size_t index2,size_t index3,size_t index4){ return this->tensor(index1,index2,index3,index4);}
+    /**
+     *  @return the full matrix representation of the two-electron operator, which is unpacked for the packed storage
+     */
+    Eigen::Tensor<double, 4> get_matrix_representation() const;
+    double get(size_t index1, size_t index2, size_t index3, size_t index4) const;
+    TwoElectronStorage get_storage() const { return this->storage; }
+    size_t get_number_of_factors() const { return static_cast<size_t>(this->factors.cols()); }
+    double get_error_bound() const { return this->error_bound; }
+    size_t get_number_of_double_precision_elements() const { return this->double_precision_elements.size(); }
+
+    /**
+     *  @return the dense matrix representation without a copy
+     *
+     *  Throws if the two-electron operator isn't in the dense storage
+     */
+    const Eigen::Tensor<double, 4>& get_tensor() const;
+
+    /**
+     *  @return the symmetry-unique elements without a copy
+     *
+     *  Throws if the two-electron operator isn't in the packed storage
+     */
+    const Eigen::VectorXd& get_packed_elements() const;
+
+    /**
+     *  @return the factors (as columns) without a copy
+     *
+     *  Throws if the two-electron operator isn't in the factorized storage
+     */
+    const Eigen::MatrixXd& get_factors() const;
 
 
     // CONSTRUCTORS
     /**
      *  Constructor based on a given @param tensor
+     *
+     *  The arguments of all constructors are moved from if they are given as an rvalue, so that the (large) matrix
+     *  representation isn't copied
      */
-    explicit TwoElectronOperator(const Eigen::Tensor<double, 4>& tensor);
+    explicit TwoElectronOperator(Eigen::Tensor<double, 4> tensor);
+
+    /**
+     *  Constructor based on the symmetry-unique elements @param packed_elements (addressed by packedIndex()) of a
+     *  two-electron operator in an orbital basis of dimension @param K
+     */
+    TwoElectronOperator(Eigen::VectorXd packed_elements, size_t K);
+
+    /**
+     *  Constructor based on the given @param factors: every column is a factor L^L as a column-major K x K matrix, such
+     *  that (pq|rs) = sum_L L^L_pq L^L_rs
+     */
+    explicit TwoElectronOperator(Eigen::MatrixXd factors);
+
+
+    // STATIC PUBLIC MEMBERS
+    static constexpr double default_error_bound = 1.0e-08;  // the default absolute error bound for the mixed storage
+
+
+    // STATIC PUBLIC METHODS
+    /**
+     *  @return the compound index of the orbital pair (p,q), which is the same as the one of (q,p)
+     */
+    static size_t pairIndex(size_t p, size_t q) { return (p >= q) ? (p * (p + 1) / 2 + q) : (q * (q + 1) / 2 + p); }
+
+    /**
+     *  @return the index of the element (pq|rs) in the packed storage, which is the same for all its symmetry-equivalent elements
+     */
+    static size_t packedIndex(size_t p, size_t q, size_t r, size_t s) { return pairIndex(pairIndex(p, q), pairIndex(r, s)); }
+
+    /**
+     *  @return the number of symmetry-unique elements of a two-electron operator in an orbital basis of dimension @param K
+     */
+    static size_t numberOfPackedElements(size_t K);
+
+    /**
+     *  @return if the mixed storage of @param number_of_elements symmetry-unique elements, of which
+     *  @param number_of_double_precision_elements are kept in double precision, is smaller than their packed storage
+     */
+    static bool isMixedStorageSmaller(size_t number_of_elements, size_t number_of_double_precision_elements);
 
 
     // PUBLIC METHODS
+    /**
+     *  Convert the matrix representation to the packed storage, keeping only the symmetry-unique elements
+     *
+     *  Note that the matrix representation is assumed to have the 8-fold permutational symmetry
+     *
+     *  A factorized matrix representation is expanded into its symmetry-unique elements
+     */
+    void pack();
+
+    /**
+     *  Convert the matrix representation to the dense storage
+     */
+    void unpack();
+
+    /**
+     *  Convert the matrix representation to the mixed storage, in which every element has an absolute error of at most
+     *  the given @param error_bound
+     *
+     *  If the mixed storage wouldn't be smaller than the packed storage, because too many elements need double
+     *  precision, the (exact) packed storage is kept instead
+     */
+    void compress(double error_bound=TwoElectronOperator::default_error_bound);
+
     /**
      *  Transform the matrix representation of a two-electron operator using the transformation matrix @param T
      *
      *  Note that the transformation matrix @param T is used as
      *      b' = b T ,
      *  in which the basis functions are collected as elements of a row vector b
+     *
+     *  The transformation matrix @param T can be rectangular (K x K'), e.g. to transform to a truncated orbital space:
+     *  the dimension of the operator then becomes K'
+     *
+     *  In the dense storage, the transformation is done as four quarter-transformations, which are matrix-matrix products,
+     *  with at most two K^4 objects at the same time
+     *  In the packed storage, the transformation is done without unpacking, using an intermediate of about K^2 K'^2/4 elements,
+     *  so that the peak memory is about three times the packed storage (for a square T)
+     *  In the factorized storage, only the factors are transformed: L^L' = T^T L^L T
+     *  In the mixed storage, the elements are transformed as in the packed storage, but they are read from the single
+     *  precision elements and the correction list, and the transformed elements are rounded again with the same error
+     *  bound, so that the packed elements are never formed in double precision. The intermediate is calculated in
+     *  batches that are at most as large as the single precision elements, so that the peak memory is about three times
+     *  the mixed storage (for a square T)
      */
     void transform(const Eigen::MatrixXd& T) override;
 
+    /**
+     *  @return the two-electron operator that is transformed with the transformation matrix @param T, in the same
+     *  storage, while this operator is left untouched
+     *
+     *  The transformation is done in the same way as in transform(), but the untransformed elements are read directly
+     *  from this operator instead of from a copy. For a rectangular (K x K') @param T, the result and the intermediates
+     *  therefore only scale with K' (e.g. K' K^3 for the dense storage)
+     */
+    TwoElectronOperator transformed(const Eigen::MatrixXd& T) const;
+
     /**
      *  Rotate the matrix representation of a two-electron operator using a unitary rotation matrix @param U
      *
@@ -58,12 +289,19 @@ public:
      *          b' = b U ,
      *        in which the basis functions are collected as elements of a row vector b.
      *      - we use the (cos, sin, -sin, cos) definition for the Jacobi rotation matrix
+     *
+     *  Since only the orbitals p and q are mixed, the Jacobi rotation is applied in-place to the elements that have at
+     *  least one index in {p, q}, which is O(K^3) work instead of a full transformation. In the mixed storage, the
+     *  changed elements are rounded again and merged into the correction list, which is O(K^3 log K + M) work with M
+     *  the number of double precision elements. In the factorized storage, it is applied directly to the rows and
+     *  columns p and q of every factor
      */
     void rotate(const GQCG::JacobiRotationParameters& jacobi_rotation_parameters) override;
 
 
     // FRIEND CLASSES
     friend class HamiltonianParameters;
+    friend class LibintCommunicator;
 };
 
 typedef std::shared_ptr<GQCG::TwoElectronOperator> TwoElectronOperator_sptr;
@@ -1,14 +1,108 @@
 #include "AOBasis.hpp"
+#include "BasisSetLibrary.hpp"
 #include "LibintCommunicator.hpp"
 
+#include <stdexcept>
+
 namespace GQCG {
 
 
+/*
+ *  PRIVATE METHODS
+ */
+
+/**
+ *  @return the shells of the given @param ao_basis, moved to the position of the corresponding atom in the given
+ *  @param atoms, which should have the same atomic numbers in the same order
+ */
+libint2::BasisSet AOBasis::recenteredBasisFunctions(const AOBasis& ao_basis, const std::vector<GQCG::Atom>& atoms) {
+
+    if (atoms.size() != ao_basis.atoms.size()) {
+        throw std::invalid_argument("The number of given atoms is not equal to the number of atoms of the basis.");
+    }
+
+    for (size_t i = 0; i < atoms.size(); i++) {
+        if (atoms[i].atomic_number != ao_basis.atoms[i].atomic_number) {
+            throw std::invalid_argument("The given atoms should have the same atomic numbers as the atoms of the basis.");
+        }
+    }
+
+
+    // Find the atom of every shell before moving them, since libint2 matches shells to atoms by their position
+    const auto shell2atom = ao_basis.basis_functions.shell2atom(GQCG::LibintCommunicator::get().interface(ao_basis.atoms));
+
+    libint2::BasisSet basis_functions = ao_basis.basis_functions;
+    for (size_t sh = 0; sh < basis_functions.size(); sh++) {
+        const auto& atom = atoms[shell2atom[sh]];
+        basis_functions[sh].move({{atom.x, atom.y, atom.z}});
+    }
+
+    return basis_functions;
+}
+
+
+
+/*
+ *  CONSTRUCTORS
+ */
+
 AOBasis::AOBasis(const GQCG::Molecule& molecule, std::string basis_set) :
     atoms (molecule.atoms),
-    basis_functions (libint2::BasisSet(std::move(basis_set), GQCG::LibintCommunicator::get().interface(this->atoms))),  // construct a libint2::BasisSet
+    basis_set_name (std::move(basis_set)),
+    basis_functions (GQCG::BasisSetLibrary::get().basisSet(this->basis_set_name, GQCG::LibintCommunicator::get().interface(this->atoms))),  // assembled from the cached basis set
     number_of_basis_functions (static_cast<size_t>(this->basis_functions.nbf()))
 {}
 
 
+/**
+ *  Copy constructor, which also copies the Schwarz bounds if they were already calculated
+ */
+AOBasis::AOBasis(const AOBasis& ao_basis) :
+    atoms (ao_basis.atoms),
+    basis_set_name (ao_basis.basis_set_name),
+    basis_functions (ao_basis.basis_functions),
+    number_of_basis_functions (ao_basis.number_of_basis_functions)
+{
+    std::lock_guard<std::mutex> lock (ao_basis.schwarz_bounds_mutex);
+    this->schwarz_bounds = ao_basis.schwarz_bounds;
+}
+
+
+/**
+ *  Constructor based on the shells of a given @param ao_basis, moved to the position of the corresponding atom in the
+ *  given @param atoms, which should have the same atomic numbers in the same order
+ *
+ *  The Schwarz bounds are calculated on their first use
+ */
+AOBasis::AOBasis(const AOBasis& ao_basis, const std::vector<GQCG::Atom>& atoms) :
+    atoms (atoms),
+    basis_set_name (ao_basis.basis_set_name),
+    basis_functions (AOBasis::recenteredBasisFunctions(ao_basis, atoms)),
+    number_of_basis_functions (ao_basis.number_of_basis_functions)
+{}
+
+
+
+/*
+ *  GETTERS
+ */
+
+/**
+ *  @return the Schwarz bounds sqrt(max|(ab|ab)|) for every shell pair (a,b)
+ *
+ *  They are calculated on first use, which is thread-safe, and are cached afterwards
+ */
+const Eigen::MatrixXd& AOBasis::get_schwarz_bounds() const {
+
+    std::lock_guard<std::mutex> lock (this->schwarz_bounds_mutex);
+
+    if (this->schwarz_bounds.size() == 0) {  // the bounds haven't been calculated yet
+        this->schwarz_bounds = GQCG::LibintCommunicator::get().calculateSchwarzBounds(this->basis_functions);
+    }
+
+    return this->schwarz_bounds;
+}
+
+
+
 }  // namespace GQCG
@@ -0,0 +1,104 @@
+#include "BasisSetLibrary.hpp"
+
+
+namespace GQCG {
+
+
+/*
+ *  PRIVATE METHODS
+ */
+
+/**
+ *  @return if the basis set with the given @param canonical_name uses Cartesian d-shells by (Gaussian) convention,
+ *  as libint2::BasisSet does
+ *
+ *  This is the same rule as libint2::BasisSet::init() uses: the 3-21G family and the 6-31G family (but not 6-311G)
+ */
+bool BasisSetLibrary::usesCartesianD(const std::string& canonical_name) {
+
+    if (canonical_name.find("3-21") == 0) {  // 3-21??g?? families
+        return true;
+    }
+
+    if ((canonical_name.find("6-31") == 0) && (canonical_name.size() > 4) && (canonical_name[4] != '1')) {  // 6-31??g?? families
+        return true;
+    }
+
+    return false;
+}
+
+
+
+/*
+ *  PUBLIC METHODS
+ */
+
+/**
+ *  @return the static singleton instance
+ */
+BasisSetLibrary& BasisSetLibrary::get() {  // need to return by reference since we deleted the relevant constructor
+    static BasisSetLibrary singleton_instance;  // instantiated on first use and guaranteed to be destroyed
+    return singleton_instance;
+}
+
+
+/**
+ *  @return the element bases of the basis set with the given @param basis_set_name
+ */
+std::shared_ptr<const BasisSetLibrary::ElementBases> BasisSetLibrary::elementBases(const std::string& basis_set_name) {
+
+    auto canonical_name = libint2::BasisSet::canonicalize_name(basis_set_name);
+
+    {
+        std::lock_guard<std::mutex> lock (this->mutex);
+
+        auto it = this->element_bases.find(canonical_name);
+        if (it != this->element_bases.end()) {
+            return it->second;
+        }
+    }
+
+
+    // The basis set is read without holding the lock, so that requests for other (cached) basis sets don't have to wait
+    // libint2::BasisSet::data_path() is the directory that contains the basis set files
+    auto filename = libint2::BasisSet::data_path() + "/" + canonical_name + ".g94";
+    auto element_bases = std::make_shared<const ElementBases>(libint2::BasisSet::read_g94_basis_library(filename, BasisSetLibrary::usesCartesianD(canonical_name)));
+
+    // Only cache basis sets that could be read. If another thread has cached the same basis set in the meantime, its element bases are used, so that they are always shared
+    std::lock_guard<std::mutex> lock (this->mutex);
+    return this->element_bases.emplace(canonical_name, element_bases).first->second;
+}
+
+
+/**
+ *  @return a libint2::BasisSet for the given @param basis_set_name on the given @param atoms, assembled from the
+ *  cached element bases
+ */
+libint2::BasisSet BasisSetLibrary::basisSet(const std::string& basis_set_name, const std::vector<libint2::Atom>& atoms) {
+
+    auto element_bases = this->elementBases(basis_set_name);
+    return libint2::BasisSet(atoms, *element_bases, basis_set_name, true);  // throw if an element isn't in the basis set
+}
+
+
+/**
+ *  @return the number of basis sets that are currently cached
+ */
+size_t BasisSetLibrary::numberOfCachedBasisSets() {
+
+    std::lock_guard<std::mutex> lock (this->mutex);
+    return this->element_bases.size();
+}
+
+
+/**
+ *  Remove all the cached basis sets
+ */
+void BasisSetLibrary::clear() {
+
+    std::lock_guard<std::mutex> lock (this->mutex);
+    this->element_bases.clear();
+}
+
+
+}  // namespace GQCG
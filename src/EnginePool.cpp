@@ -0,0 +1,103 @@
+#include "EnginePool.hpp"
+
+
+namespace GQCG {
+
+
+/*
+ *  LEASE
+ */
+
+/**
+ *  Constructor based on the @param pool that the @param engine with the given @param key was checked out of
+ */
+EnginePool::Lease::Lease(GQCG::EnginePool* pool, const Key& key, std::unique_ptr<libint2::Engine> engine) :
+    pool (pool),
+    key (key),
+    engine (std::move(engine))
+{}
+
+
+/**
+ *  Return the engine to the pool
+ */
+EnginePool::Lease::~Lease() {
+
+    if (this->engine) {  // a moved-from lease doesn't own an engine anymore
+        this->pool->checkin(this->key, std::move(this->engine));
+    }
+}
+
+
+
+/*
+ *  PRIVATE METHODS
+ */
+
+/**
+ *  Return the given @param engine with the given @param key to the pool
+ */
+void EnginePool::checkin(const Key& key, std::unique_ptr<libint2::Engine> engine) {
+
+    std::lock_guard<std::mutex> lock (this->mutex);
+    this->idle_engines[key].push_back(std::move(engine));
+}
+
+
+
+/*
+ *  PUBLIC METHODS
+ */
+
+/**
+ *  @return a lease on an engine for the given @param operator_type, @param max_nprim, @param max_l and @param deriv_order
+ */
+EnginePool::Lease EnginePool::checkout(libint2::Operator operator_type, size_t max_nprim, int max_l, int deriv_order) {
+
+    Key key (operator_type, max_nprim, max_l, deriv_order);
+
+    {
+        std::lock_guard<std::mutex> lock (this->mutex);
+
+        auto& engines = this->idle_engines[key];
+        if (!engines.empty()) {
+            auto engine = std::move(engines.back());
+            engines.pop_back();
+            return Lease(this, key, std::move(engine));
+        }
+    }
+
+
+    // Constructing an engine is expensive, so we don't hold the lock while doing so
+    std::unique_ptr<libint2::Engine> engine (new libint2::Engine(operator_type, max_nprim, max_l, deriv_order));
+    return Lease(this, key, std::move(engine));
+}
+
+
+/**
+ *  @return the number of engines that are currently idle in the pool
+ */
+size_t EnginePool::numberOfIdleEngines() {
+
+    std::lock_guard<std::mutex> lock (this->mutex);
+
+    size_t number_of_idle_engines = 0;
+    for (const auto& key_engines : this->idle_engines) {
+        number_of_idle_engines += key_engines.second.size();
+    }
+
+    return number_of_idle_engines;
+}
+
+
+/**
+ *  Destroy all the idle engines
+ */
+void EnginePool::clear() {
+
+    std::lock_guard<std::mutex> lock (this->mutex);
+    this->idle_engines.clear();
+}
+
+
+}  // namespace GQCG
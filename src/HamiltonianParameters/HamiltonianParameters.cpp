@@ -1,37 +1,104 @@
 #include "HamiltonianParameters/HamiltonianParameters.hpp"
 
-#include "miscellaneous.hpp"
+#include <cmath>
+#include <stdexcept>
 
 
 namespace GQCG {
 
 
+/*
+ *  PRIVATE METHODS
+ */
+
+/**
+ *  Transform the two-electron operator with the transformation matrix @param T, or compose @param T with the
+ *  pending transformation in the lazy mode
+ */
+void HamiltonianParameters::transformTwoElectronOperator(const Eigen::MatrixXd& T) {
+
+    if (!this->lazy) {
+        this->g.transform(T);
+        return;
+    }
+
+    // b'' = b' T = b T_pending T, which is only a K^3 matrix product
+    if (this->pending_transformation.size() == 0) {
+        this->pending_transformation = T;
+    } else {
+        this->pending_transformation = this->pending_transformation * T;
+    }
+}
+
+
+/**
+ *  Apply the pending transformation (if any) to the two-electron operator
+ */
+void HamiltonianParameters::applyPendingTransformation() const {
+
+    if (this->pending_transformation.size() == 0) {
+        return;
+    }
+
+    this->g.transform(this->pending_transformation);
+    this->pending_transformation = Eigen::MatrixXd ();
+}
+
+
+
 /*
  *  CONSTRUCTORS
  */
 
 /**
  *  Constructor based on a given @param ao_basis_ptr, overlap @param S, one-electron operator @param h, two-electron
- *  operator @param g and a transformation matrix between the current molecular orbitals and the atomic orbitals
- *  @param C
+ *  operator @param g, a transformation matrix between the current molecular orbitals and the atomic orbitals
+ *  @param C and a scalar @param core_energy
+ *
+ *  There can be less molecular orbitals (i.e. columns of @param C) than atomic orbitals, e.g. for an active space
+ *
+ *  The arguments are moved from if they are given as an rvalue, so that the operators aren't copied
  */
-HamiltonianParameters::HamiltonianParameters(std::shared_ptr<GQCG::AOBasis> ao_basis_sptr, const GQCG::OneElectronOperator& S, const GQCG::OneElectronOperator& h, const GQCG::TwoElectronOperator& g, const Eigen::MatrixXd& C) :
+HamiltonianParameters::HamiltonianParameters(std::shared_ptr<GQCG::AOBasis> ao_basis_sptr, GQCG::OneElectronOperator S, GQCG::OneElectronOperator h, GQCG::TwoElectronOperator g, Eigen::MatrixXd C, double core_energy) :
     BaseHamiltonianParameters(std::move(ao_basis_sptr)),
-    S (S),
-    h (h),
-    g (g),
-    C (C)
+    S (std::move(S)),
+    h (std::move(h)),
+    g (std::move(g)),
+    C (std::move(C)),
+    core_energy (core_energy),
+    lazy (false)
 {
     // Check if the dimensions of all matrix representations are compatible
-    auto K = this->ao_basis_sptr->number_of_basis_functions;
+    auto nbf = this->ao_basis_sptr->number_of_basis_functions;
+    auto K = static_cast<size_t>(this->C.cols());  // the number of molecular orbitals
 
-    if ((S.dim != K) || (h.dim != K) || (g.dim != K) || (C.cols() != K) || (C.rows() != K)) {
+    if ((this->C.rows() != nbf) || (K > nbf) || (this->S.dim != K) || (this->h.dim != K) || (this->g.dim != K)) {
         throw std::invalid_argument("The dimensions of the operators and coefficient matrix are incompatible.");
     }
 }
 
 
 
+/*
+ *  SETTERS
+ */
+
+/**
+ *  Turn the lazy mode on or off, according to @param lazy
+ *
+ *  Turning the lazy mode off applies the pending transformation
+ */
+void HamiltonianParameters::set_lazy(bool lazy) {
+
+    if (!lazy) {
+        this->applyPendingTransformation();
+    }
+
+    this->lazy = lazy;
+}
+
+
+
 /*
  *  PUBLIC METHODS
  */
@@ -53,7 +120,7 @@ void HamiltonianParameters::transform(const Eigen::MatrixXd& T) {
     this->S.transform(T);
 
     this->h.transform(T);
-    this->g.transform(T);
+    this->transformTwoElectronOperator(T);
 
     this->C = this->C * T;  // use the correct transformation formula for subsequent transformations
 }
@@ -73,8 +140,8 @@ void HamiltonianParameters::rotate(const Eigen::MatrixXd& U) {
 
     // A rotation leaves the overlap matrix invariant, so we don't have to transform it
 
-    this->h.rotate(U);
-    this->g.rotate(U);
+    this->h.rotate(U);  // also checks if U is unitary
+    this->transformTwoElectronOperator(U);
 
     this->C = this->C * U;
 }
@@ -95,13 +162,194 @@ void HamiltonianParameters::rotate(const GQCG::JacobiRotationParameters& jacobi_
     // A rotation leaves the overlap matrix invariant, so we don't have to transform it
 
     this->h.rotate(jacobi_rotation_parameters);
-    this->g.rotate(jacobi_rotation_parameters);
 
 
-    // Create a Jacobi rotation matrix to transform the coefficient matrix with
+    // Only the columns p and q of the coefficient matrix (and of the pending transformation) change (cfr. C' = C J), so we don't construct the Jacobi rotation matrix
+    Eigen::JacobiRotation<double> jacobi (std::cos(jacobi_rotation_parameters.get_angle()), std::sin(jacobi_rotation_parameters.get_angle()));
+    auto p = jacobi_rotation_parameters.get_p();
+    auto q = jacobi_rotation_parameters.get_q();
+
+    if (this->lazy) {
+        if (this->pending_transformation.size() == 0) {
+            this->pending_transformation = Eigen::MatrixXd::Identity(this->g.dim, this->g.dim);
+        }
+        this->pending_transformation.applyOnTheRight(p, q, jacobi);
+    } else {
+        this->g.rotate(jacobi_rotation_parameters);
+    }
+
+    this->C.applyOnTheRight(p, q, jacobi);
+}
+
+
+/**
+ *  Apply the sequence of Jacobi rotations given by @param jacobi_rotation_parameters (in that order), which gives the
+ *  same result as rotating with every one of them separately
+ *
+ *  A single Jacobi rotation of the dense two-electron operator touches about 8K^3 elements (with strided memory access),
+ *  while a transformation with a full rotation matrix costs about 8K^5 floating point operations at matrix-matrix
+ *  product speed. Therefore, a sequence of more than about K^2/4 Jacobi rotations is first accumulated (in O(K) per
+ *  Jacobi rotation) in one rotation matrix U = J_1 J_2 ... J_n, with which the operators are transformed only once
+ */
+void HamiltonianParameters::rotate(const std::vector<GQCG::JacobiRotationParameters>& jacobi_rotation_parameters) {
+
     size_t K = this->h.dim;  // number of spatial orbitals
-    auto J = GQCG::jacobiRotationMatrix(jacobi_rotation_parameters, K);
-    this->C = this->C * J;
+
+    if (4 * jacobi_rotation_parameters.size() <= K * K) {  // a short sequence is cheaper to apply rotation by rotation
+        for (const auto& jacobi_rotation_parameter : jacobi_rotation_parameters) {
+            this->rotate(jacobi_rotation_parameter);
+        }
+        return;
+    }
+
+
+    // Accumulate the Jacobi rotations in one rotation matrix, as U = I J_1 J_2 ... J_n
+    Eigen::MatrixXd U = Eigen::MatrixXd::Identity(K, K);
+    for (const auto& jacobi_rotation_parameter : jacobi_rotation_parameters) {
+        Eigen::JacobiRotation<double> jacobi (std::cos(jacobi_rotation_parameter.get_angle()), std::sin(jacobi_rotation_parameter.get_angle()));
+        U.applyOnTheRight(jacobi_rotation_parameter.get_p(), jacobi_rotation_parameter.get_q(), jacobi);
+    }
+
+
+    // A rotation leaves the overlap matrix invariant, so we don't have to transform it
+    // Since U is unitary by construction, we transform directly instead of checking its unitarity (to which rounding errors of long sequences could add up)
+    this->h.transform(U);
+    this->transformTwoElectronOperator(U);
+
+    this->C = this->C * U;
+}
+
+
+
+/**
+ *  @return the HamiltonianParameters in the active space of the given @param active_orbitals, in which the given
+ *  @param inactive_orbitals are frozen (i.e. doubly occupied)
+ *
+ *  For orthonormal molecular orbitals, with i, j inactive and t, u, v, w active orbitals, the active-space
+ *  HamiltonianParameters have
+ *      - the effective one-electron operator h_tu + sum_i (2 (tu|ii) - (ti|iu)), in which the interaction with the
+ *        core electrons is folded in
+ *      - the active block (tu|vw) of the two-electron operator, in the same storage
+ *      - the core energy sum_i 2 h_ii + sum_ij (2 (ii|jj) - (ij|ji)), which is added to the current core energy
+ *      - the active block of S and the active columns of C
+ */
+HamiltonianParameters HamiltonianParameters::reduceToActiveSpace(const std::vector<size_t>& inactive_orbitals, const std::vector<size_t>& active_orbitals) const {
+
+    // Check if the orbitals are valid and don't appear more than once
+    size_t K = this->h.dim;  // number of spatial orbitals
+    if (active_orbitals.empty()) {
+        throw std::invalid_argument("The active space should contain at least one orbital.");
+    }
+
+    std::vector<bool> is_selected (K, false);
+    std::vector<size_t> orbitals (inactive_orbitals);  // the selected orbitals: first the inactive, then the active ones
+    orbitals.insert(orbitals.end(), active_orbitals.begin(), active_orbitals.end());
+    for (auto orbital : orbitals) {
+        if (orbital >= K) {
+            throw std::invalid_argument("The given orbital indices should be smaller than the number of orbitals.");
+        }
+        if (is_selected[orbital]) {
+            throw std::invalid_argument("Every orbital should appear only once in the inactive and active orbitals.");
+        }
+        is_selected[orbital] = true;
+    }
+
+
+    // Find the two-electron operator and the indices of the selected orbitals in it
+    // In the lazy mode, we only apply the columns of the pending transformation that belong to the selected orbitals:
+    // the transformed operator is read directly from g, and only has the dimension of the selected orbitals
+    const GQCG::TwoElectronOperator* g_ptr = &this->g;
+    std::vector<size_t> indices (orbitals);
+    GQCG::TwoElectronOperator g_transformed (Eigen::Tensor<double, 4> (0, 0, 0, 0));  // only used in the lazy mode
+
+    if (this->pending_transformation.size() != 0) {
+        Eigen::MatrixXd T (this->pending_transformation.rows(), orbitals.size());
+        for (size_t i = 0; i < orbitals.size(); i++) {
+            T.col(i) = this->pending_transformation.col(orbitals[i]);
+            indices[i] = i;
+        }
+
+        g_transformed = this->g.transformed(T);
+        g_ptr = &g_transformed;
+    }
+
+    const auto& g_selected = *g_ptr;
+    auto n_inactive = inactive_orbitals.size();
+    auto n_active = active_orbitals.size();
+    const size_t* inactive = indices.data();  // the indices in g of the inactive orbitals
+    const size_t* active = indices.data() + n_inactive;  // the indices in g of the active orbitals
+
+
+    // Calculate the core energy
+    double core_energy = this->core_energy;
+    for (size_t i = 0; i < n_inactive; i++) {
+        core_energy += 2 * this->h.get(inactive_orbitals[i], inactive_orbitals[i]);
+
+        for (size_t j = 0; j < n_inactive; j++) {
+            core_energy += 2 * g_selected.get(inactive[i], inactive[i], inactive[j], inactive[j]) - g_selected.get(inactive[i], inactive[j], inactive[j], inactive[i]);
+        }
+    }
+
+
+    // Calculate the active blocks of S and the effective one-electron operator, and the active columns of C
+    Eigen::MatrixXd S_active (n_active, n_active);
+    Eigen::MatrixXd h_active (n_active, n_active);
+    Eigen::MatrixXd C_active (this->C.rows(), n_active);
+    for (size_t t = 0; t < n_active; t++) {
+        C_active.col(t) = this->C.col(active_orbitals[t]);
+
+        for (size_t u = 0; u < n_active; u++) {
+            S_active(t, u) = this->S.get(active_orbitals[t], active_orbitals[u]);
+            h_active(t, u) = this->h.get(active_orbitals[t], active_orbitals[u]);
+
+            for (size_t i = 0; i < n_inactive; i++) {  // the Coulomb and exchange interaction with the core electrons
+                h_active(t, u) += 2 * g_selected.get(active[t], active[u], inactive[i], inactive[i]) - g_selected.get(active[t], inactive[i], inactive[i], active[u]);
+            }
+        }
+    }
+
+
+    // Extract the active block of the two-electron operator, keeping its storage
+    auto n = static_cast<long>(n_active);
+    Eigen::Tensor<double, 4> g_active_tensor;
+    Eigen::MatrixXd g_active_factors;
+
+    if (g_selected.get_storage() == GQCG::TwoElectronStorage::factorized) {
+        auto K_g = g_selected.dim;
+        const auto& factors = g_selected.get_factors();
+
+        g_active_factors = Eigen::MatrixXd (n*n, factors.cols());
+        for (long t = 0; t < n; t++) {
+            for (long u = 0; u < n; u++) {
+                g_active_factors.row(t + n * u) = factors.row(active[t] + K_g * active[u]);
+            }
+        }
+
+    } else {
+        g_active_tensor = Eigen::Tensor<double, 4> (n, n, n, n);
+        for (long t = 0; t < n; t++) {
+            for (long u = 0; u < n; u++) {
+                for (long v = 0; v < n; v++) {
+                    for (long w = 0; w < n; w++) {
+                        g_active_tensor(t, u, v, w) = g_selected.get(active[t], active[u], active[v], active[w]);
+                    }
+                }
+            }
+        }
+    }
+
+    auto storage = g_selected.get_storage();
+    GQCG::TwoElectronOperator g_active = (storage == GQCG::TwoElectronStorage::factorized) ? GQCG::TwoElectronOperator(std::move(g_active_factors))
+                                                                                           : GQCG::TwoElectronOperator(std::move(g_active_tensor));
+    if (storage == GQCG::TwoElectronStorage::packed) {
+        g_active.pack();
+    } else if (storage == GQCG::TwoElectronStorage::mixed) {
+        g_active.compress(g_selected.get_error_bound());
+    }
+
+
+    return HamiltonianParameters(this->ao_basis_sptr, GQCG::OneElectronOperator(std::move(S_active)), GQCG::OneElectronOperator(std::move(h_active)),
+                                 std::move(g_active), std::move(C_active), core_energy);
 }
 
 
@@ -6,6 +6,30 @@
 namespace GQCG {
 
 
+/**
+ *  @return HamiltonianParameters corresponding to the molecular Hamiltonian for the given @param ao_basis_sptr, with
+ *  the already calculated two-electron integrals @param g
+ *
+ *  The overlap, kinetic and nuclear attraction integrals are calculated in one pass, and the initial transformation
+ *  matrix is the identity matrix
+ */
+static GQCG::HamiltonianParameters assembleMolecularHamiltonianParameters(std::shared_ptr<GQCG::AOBasis> ao_basis_sptr, GQCG::TwoElectronOperator g) {
+
+    // Calculate the one-electron integrals for the molecular Hamiltonian
+    auto one_electron_operators = GQCG::LibintCommunicator::get().calculateOneElectronIntegrals({libint2::Operator::overlap, libint2::Operator::kinetic, libint2::Operator::nuclear}, *ao_basis_sptr);
+    auto S = std::move(one_electron_operators[0]);
+    auto H = one_electron_operators[1] + one_electron_operators[2];
+
+
+    // Construct the initial transformation matrix: the identity matrix
+    auto nbf = ao_basis_sptr->get_number_of_basis_functions();
+    Eigen::MatrixXd C = Eigen::MatrixXd::Identity(nbf, nbf);
+
+
+    return HamiltonianParameters(std::move(ao_basis_sptr), std::move(S), std::move(H), std::move(g), std::move(C));
+}
+
+
 /**
  *  @return HamiltonianParameters corresponding to the molecular Hamiltonian for the given @param ao_basis_sptr
  *
@@ -15,26 +39,70 @@ namespace GQCG {
  *          - nuclear attraction
  *      - two-electron contributions:
  *          - Coulomb repulsion
+ *
+ *  The two-electron integrals are stored in the given @param storage
  */
-GQCG::HamiltonianParameters constructMolecularHamiltonianParameters(std::shared_ptr<GQCG::AOBasis> ao_basis_sptr) {
-
-    // Calculate the integrals for the molecular Hamiltonian
-    auto S = GQCG::LibintCommunicator::get().calculateOneElectronIntegrals(libint2::Operator::overlap, *ao_basis_sptr);
-    auto T = GQCG::LibintCommunicator::get().calculateOneElectronIntegrals(libint2::Operator::kinetic, *ao_basis_sptr);
-    auto V = GQCG::LibintCommunicator::get().calculateOneElectronIntegrals(libint2::Operator::nuclear, *ao_basis_sptr);
-    auto H = T + V;
-    
-    auto g = GQCG::LibintCommunicator::get().calculateTwoElectronIntegrals(libint2::Operator::coulomb, *ao_basis_sptr);
-    
-    
-    // Construct the initial transformation matrix: the identity matrix
-    auto nbf = ao_basis_sptr->get_number_of_basis_functions();
-    Eigen::MatrixXd C = Eigen::MatrixXd::Identity(nbf, nbf);
-    
-    
-    return HamiltonianParameters(ao_basis_sptr, S, H, g, C);
+GQCG::HamiltonianParameters constructMolecularHamiltonianParameters(std::shared_ptr<GQCG::AOBasis> ao_basis_sptr, GQCG::TwoElectronStorage storage) {
+
+    auto g = GQCG::LibintCommunicator::get().calculateTwoElectronIntegrals(libint2::Operator::coulomb, *ao_basis_sptr, storage);
+    return GQCG::assembleMolecularHamiltonianParameters(std::move(ao_basis_sptr), std::move(g));
+}
+
+
+/**
+ *  @return HamiltonianParameters corresponding to the molecular Hamiltonian for the given @param ao_basis_sptr, in which
+ *  the two-electron integrals are represented by a pivoted Cholesky decomposition with the given @param cholesky_tolerance
+ */
+GQCG::HamiltonianParameters constructCholeskyMolecularHamiltonianParameters(std::shared_ptr<GQCG::AOBasis> ao_basis_sptr, double cholesky_tolerance) {
+
+    auto g = GQCG::LibintCommunicator::get().calculateCholeskyDecomposedTwoElectronIntegrals(libint2::Operator::coulomb, *ao_basis_sptr, cholesky_tolerance);
+    return GQCG::assembleMolecularHamiltonianParameters(std::move(ao_basis_sptr), std::move(g));
 }
 
 
+/**
+ *  @return HamiltonianParameters corresponding to the molecular Hamiltonian for the given @param ao_basis_sptr, in which
+ *  the two-electron integrals are density-fitted in the given @param auxiliary_basis_sptr
+ */
+GQCG::HamiltonianParameters constructDensityFittedMolecularHamiltonianParameters(std::shared_ptr<GQCG::AOBasis> ao_basis_sptr, std::shared_ptr<GQCG::AOBasis> auxiliary_basis_sptr) {
+
+    auto g = GQCG::LibintCommunicator::get().calculateDensityFittedIntegrals(*ao_basis_sptr, *auxiliary_basis_sptr);
+    return GQCG::assembleMolecularHamiltonianParameters(std::move(ao_basis_sptr), std::move(g));
+}
+
+
+
+
+/**
+ *  Call the given @param visitor with the molecular HamiltonianParameters for every frame in the given @param trajectory,
+ *  in which every frame contains the atoms of @param ao_basis_sptr at other positions
+ *
+ *  The two-electron integrals are stored in the given @param storage
+ */
+void visitMolecularHamiltonianParameters(std::shared_ptr<GQCG::AOBasis> ao_basis_sptr, const std::vector<std::vector<GQCG::Atom>>& trajectory, const GQCG::HamiltonianParametersVisitor& visitor, GQCG::TwoElectronStorage storage) {
+
+    // In the dense and packed storage, the two-electron integrals of the previous frame are recalculated in place, so
+    // that their memory is reused. The mixed storage is compressed, so it is calculated anew for every frame
+    const bool recalculate_in_place = (storage == GQCG::TwoElectronStorage::dense) || (storage == GQCG::TwoElectronStorage::packed);
+    auto g = (storage == GQCG::TwoElectronStorage::dense) ? GQCG::TwoElectronOperator(Eigen::Tensor<double, 4> ()) : GQCG::TwoElectronOperator(Eigen::VectorXd(), 0);  // resized in the first frame
+
+    for (size_t frame = 0; frame < trajectory.size(); frame++) {
+
+        // Recenter a copy of the basis, so that the given basis is never modified
+        auto frame_basis_sptr = std::make_shared<GQCG::AOBasis>(*ao_basis_sptr, trajectory[frame]);
+
+        if (recalculate_in_place) {
+            GQCG::LibintCommunicator::get().recalculateTwoElectronIntegrals(libint2::Operator::coulomb, *frame_basis_sptr, g);
+        } else {
+            g = GQCG::LibintCommunicator::get().calculateTwoElectronIntegrals(libint2::Operator::coulomb, *frame_basis_sptr, storage);
+        }
+
+        auto ham_par = GQCG::assembleMolecularHamiltonianParameters(std::move(frame_basis_sptr), std::move(g));
+        visitor(frame, ham_par);
+
+        g = std::move(ham_par.g);  // take the two-electron integrals back, so that they can be recalculated in place
+    }
+}
+
 
 }  // namespace GQCG
@@ -0,0 +1,339 @@
+#include "IntegralCache.hpp"
+
+#include "LibintCommunicator.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+namespace GQCG {
+
+
+/*
+ *  MAPPEDTWOELECTRONINTEGRALS
+ */
+
+/**
+ *  Constructor based on a mapping of @param length bytes at the given @param address, in which the symmetry-unique
+ *  two-electron integrals in an orbital basis of dimension @param K start at the given @param offset
+ */
+MappedTwoElectronIntegrals::MappedTwoElectronIntegrals(void* address, size_t length, size_t K, size_t offset) :
+    address (address),
+    length (length),
+    dim (K),
+    packed_elements (reinterpret_cast<const double*>(static_cast<const char*>(address) + offset))
+{}
+
+
+/**
+ *  Move constructor, which takes over the mapping of @param other
+ */
+MappedTwoElectronIntegrals::MappedTwoElectronIntegrals(MappedTwoElectronIntegrals&& other) noexcept :
+    address (other.address),
+    length (other.length),
+    dim (other.dim),
+    packed_elements (other.packed_elements)
+{
+    other.address = nullptr;  // the moved-from object doesn't unmap anything
+}
+
+
+/**
+ *  Destructor, which unmaps the cache file
+ */
+MappedTwoElectronIntegrals::~MappedTwoElectronIntegrals() {
+
+    if (this->address) {
+        munmap(this->address, this->length);
+    }
+}
+
+
+
+/*
+ *  PRIVATE METHODS
+ */
+
+/**
+ *  @return a file descriptor for the cache file of the given @param ao_basis, positioned directly after its header, or
+ *  -1 if there is no valid cache file
+ *
+ *  Only the header is read: a file is valid if its header corresponds to the requested integrals and its size
+ *  corresponds to the number of elements in the header
+ */
+int IntegralCache::openCacheFile(const GQCG::AOBasis& ao_basis) const {
+
+    int file_descriptor = open(this->filename(ao_basis).c_str(), O_RDONLY);
+    if (file_descriptor == -1) {  // there is no cache file yet
+        return -1;
+    }
+
+    Header header;
+    struct stat file_status;
+    if ((fstat(file_descriptor, &file_status) == -1) || (read(file_descriptor, &header, sizeof(Header)) != static_cast<ssize_t>(sizeof(Header)))) {
+        close(file_descriptor);
+        return -1;
+    }
+
+
+    // Check if the header corresponds to the requested integrals
+    auto nbf = ao_basis.get_number_of_basis_functions();
+    auto number_of_elements = GQCG::TwoElectronOperator::numberOfPackedElements(nbf);
+
+    if ((std::strncmp(header.magic, "GQCGERI", sizeof(header.magic)) != 0) ||
+        (header.version != IntegralCache::version) ||
+        (header.fingerprint != IntegralCache::fingerprint(ao_basis)) ||
+        (header.number_of_basis_functions != nbf) ||
+        (header.number_of_elements != number_of_elements) ||
+        (static_cast<size_t>(file_status.st_size) != sizeof(Header) + number_of_elements * sizeof(double))) {
+
+        close(file_descriptor);
+        return -1;
+    }
+
+    return file_descriptor;
+}
+
+
+/**
+ *  @return the packed two-electron integrals that are stored in the cache for the given @param ao_basis, or an empty
+ *  vector if there is no valid cache file
+ *
+ *  The integrals are read directly into the returned vector
+ */
+Eigen::VectorXd IntegralCache::load(const GQCG::AOBasis& ao_basis) const {
+
+    int file_descriptor = this->openCacheFile(ao_basis);
+    if (file_descriptor == -1) {
+        return Eigen::VectorXd();
+    }
+
+    Eigen::VectorXd packed_elements (GQCG::TwoElectronOperator::numberOfPackedElements(ao_basis.get_number_of_basis_functions()));
+
+
+    // read() may return less than the requested number of bytes, so we keep reading until all the elements are read
+    auto buffer = reinterpret_cast<char*>(packed_elements.data());
+    size_t remaining_bytes = packed_elements.size() * sizeof(double);
+    while (remaining_bytes > 0) {
+        auto read_bytes = read(file_descriptor, buffer, remaining_bytes);
+        if (read_bytes <= 0) {  // an error, or the file was truncated in the meantime
+            close(file_descriptor);
+            return Eigen::VectorXd();
+        }
+
+        buffer += read_bytes;
+        remaining_bytes -= static_cast<size_t>(read_bytes);
+    }
+
+    close(file_descriptor);
+    return packed_elements;
+}
+
+
+/**
+ *  Store the given @param packed_elements as the two-electron integrals for the given @param ao_basis
+ *
+ *  @return if the cache file could be written: if not (e.g. on a read-only or full disk), the temporary file is removed
+ *  and the cache is left untouched
+ */
+bool IntegralCache::store(const GQCG::AOBasis& ao_basis, const Eigen::VectorXd& packed_elements) const {
+
+    Header header {};
+    std::strncpy(header.magic, "GQCGERI", sizeof(header.magic));
+    header.version = IntegralCache::version;
+    header.fingerprint = IntegralCache::fingerprint(ao_basis);
+    header.number_of_basis_functions = ao_basis.get_number_of_basis_functions();
+    header.number_of_elements = static_cast<uint64_t>(packed_elements.size());
+
+
+    // Write to a file that is unique for this process and thread, and rename it afterwards, so that the cache file appears atomically
+    auto filename = this->filename(ao_basis);
+
+    std::ostringstream temporary_filename_stream;
+    temporary_filename_stream << filename << ".tmp" << getpid() << '_' << std::this_thread::get_id();
+    auto temporary_filename = temporary_filename_stream.str();
+
+    std::ofstream output_file_stream (temporary_filename, std::ios::binary);
+    if (!output_file_stream.good()) {  // e.g. the directory doesn't exist or isn't writable
+        return false;
+    }
+
+    output_file_stream.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+    output_file_stream.write(reinterpret_cast<const char*>(packed_elements.data()), packed_elements.size() * sizeof(double));
+    output_file_stream.close();
+
+    if (!output_file_stream.good() || (std::rename(temporary_filename.c_str(), filename.c_str()) != 0)) {  // e.g. the disk is full
+        std::remove(temporary_filename.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+
+
+/*
+ *  CONSTRUCTORS
+ */
+
+/**
+ *  Constructor based on the @param directory in which the cache files are stored
+ */
+IntegralCache::IntegralCache(const std::string& directory) :
+    directory (directory)
+{}
+
+
+
+/*
+ *  STATIC PUBLIC METHODS
+ */
+
+/**
+ *  @return a fingerprint of the given @param ao_basis, based on its shells (i.e. their exponents, contractions and
+ *  centers) and the current Schwarz threshold and accuracy of the LibintCommunicator
+ */
+uint64_t IntegralCache::fingerprint(const GQCG::AOBasis& ao_basis) {
+
+    uint64_t hash = 14695981039346656037ULL;  // the FNV-1a offset basis
+    auto add_bytes = [&hash] (const void* data, size_t size) {
+        const auto bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; i++) {
+            hash ^= bytes[i];
+            hash *= 1099511628211ULL;  // the FNV-1a prime
+        }
+    };
+
+
+    // The shells determine the integrals, so bases with differently spelled names (e.g. "STO-3G" and "sto-3g") get the same fingerprint
+    for (const auto& shell : ao_basis.basis_functions) {
+        auto number_of_primitives = static_cast<uint64_t>(shell.alpha.size());
+        add_bytes(&number_of_primitives, sizeof(number_of_primitives));
+        add_bytes(shell.alpha.data(), shell.alpha.size() * sizeof(double));
+
+        for (const auto& contraction : shell.contr) {
+            auto l = static_cast<uint64_t>(contraction.l);
+            auto pure = static_cast<uint64_t>(contraction.pure);
+            add_bytes(&l, sizeof(l));
+            add_bytes(&pure, sizeof(pure));
+            add_bytes(contraction.coeff.data(), contraction.coeff.size() * sizeof(double));
+        }
+
+        add_bytes(shell.O.data(), shell.O.size() * sizeof(double));
+    }
+
+    auto schwarz_threshold = GQCG::LibintCommunicator::get().get_schwarz_threshold();  // screened integrals are different integrals
+    add_bytes(&schwarz_threshold, sizeof(double));
+
+    auto accuracy = GQCG::LibintCommunicator::get().get_accuracy();
+    add_bytes(&accuracy, sizeof(double));
+
+    return hash;
+}
+
+
+
+/*
+ *  PUBLIC METHODS
+ */
+
+/**
+ *  @return the name of the cache file for the given @param ao_basis
+ */
+std::string IntegralCache::filename(const GQCG::AOBasis& ao_basis) const {
+
+    std::ostringstream filename;
+    filename << this->directory << "/gqcg_eri_" << std::hex << std::setw(16) << std::setfill('0') << IntegralCache::fingerprint(ao_basis) << ".bin";
+
+    return filename.str();
+}
+
+
+/**
+ *  @return if there is a valid cache file for the given @param ao_basis
+ */
+bool IntegralCache::contains(const GQCG::AOBasis& ao_basis) const {
+
+    int file_descriptor = this->openCacheFile(ao_basis);  // only the header is read
+    if (file_descriptor == -1) {
+        return false;
+    }
+
+    close(file_descriptor);
+    return true;
+}
+
+
+/**
+ *  @return the Coulomb two-electron integrals in the given @param ao_basis, in the given @param storage
+ *
+ *  If they are present in the cache, they are read from the cache file. Otherwise, they are calculated by the
+ *  LibintCommunicator and stored in the cache
+ */
+GQCG::TwoElectronOperator IntegralCache::calculateTwoElectronIntegrals(const GQCG::AOBasis& ao_basis, GQCG::TwoElectronStorage storage) const {
+
+    if (storage == GQCG::TwoElectronStorage::factorized) {
+        throw std::invalid_argument("The integral cache only provides the dense, packed or mixed two-electron integrals.");
+    }
+
+
+    auto packed_elements = this->load(ao_basis);
+    bool is_cached = (packed_elements.size() != 0);
+
+    auto g = is_cached ? GQCG::TwoElectronOperator(std::move(packed_elements), ao_basis.get_number_of_basis_functions())
+                       : GQCG::LibintCommunicator::get().calculateTwoElectronIntegrals(libint2::Operator::coulomb, ao_basis, GQCG::TwoElectronStorage::packed);
+    if (!is_cached) {  // the integrals had to be calculated: if they can't be stored, they are just not cached
+        this->store(ao_basis, g.get_packed_elements());
+    }
+    if (storage == GQCG::TwoElectronStorage::dense) {
+        g.unpack();
+    } else if (storage == GQCG::TwoElectronStorage::mixed) {
+        g.compress();
+    }
+
+    return g;
+}
+
+
+/**
+ *  @return a read-only memory mapping of the Coulomb two-electron integrals in the given @param ao_basis
+ *
+ *  If they aren't present in the cache yet, they are calculated by the LibintCommunicator and stored in the cache
+ *  first. Throws if the cache file can't be written or mapped
+ */
+GQCG::MappedTwoElectronIntegrals IntegralCache::map(const GQCG::AOBasis& ao_basis) const {
+
+    int file_descriptor = this->openCacheFile(ao_basis);
+    if (file_descriptor == -1) {  // the integrals have to be calculated and stored first
+        auto g = GQCG::LibintCommunicator::get().calculateTwoElectronIntegrals(libint2::Operator::coulomb, ao_basis, GQCG::TwoElectronStorage::packed);
+        if (!this->store(ao_basis, g.get_packed_elements()) || ((file_descriptor = this->openCacheFile(ao_basis)) == -1)) {
+            throw std::runtime_error("The integral cache file could not be written, so it can't be mapped. Maybe you specified a wrong directory?");
+        }
+    }
+
+
+    // The mapping stays valid after closing the file, and also if the file is replaced by another process in the meantime
+    auto nbf = ao_basis.get_number_of_basis_functions();
+    size_t length = sizeof(Header) + GQCG::TwoElectronOperator::numberOfPackedElements(nbf) * sizeof(double);
+
+    void* address = mmap(nullptr, length, PROT_READ, MAP_SHARED, file_descriptor, 0);
+    close(file_descriptor);
+    if (address == MAP_FAILED) {
+        throw std::runtime_error("The integral cache file could not be mapped.");
+    }
+
+    return GQCG::MappedTwoElectronIntegrals(address, length, nbf, sizeof(Header));
+}
+
+
+}  // namespace GQCG
@@ -1,7 +1,17 @@
 #include "LibintCommunicator.hpp"
 
+#include <Eigen/Eigenvalues>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <exception>
 #include <iostream>
+#include <limits>
 #include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <tuple>
 
 
 
@@ -15,7 +25,12 @@ namespace GQCG {
 /**
  *  Private constructor as required by the singleton class design
  */
-LibintCommunicator::LibintCommunicator() {
+LibintCommunicator::LibintCommunicator() :
+    number_of_threads (1),
+    schwarz_threshold (0.0),
+    accuracy (std::numeric_limits<double>::epsilon()),  // libint's default precision
+    number_of_screened_quartets (0)
+{
     libint2::initialize();
 }
 
@@ -24,10 +39,140 @@ LibintCommunicator::LibintCommunicator() {
  *  Private destructor as required by the singleton class design
  */
 LibintCommunicator::~LibintCommunicator() {
+    this->engine_pool.clear();  // the engines should be destroyed before libint2 is finalized
     libint2::finalize();
 }
 
 
+/**
+ *  Execute the given @param task on @member number_of_threads threads and wait for all of them to finish
+ *
+ *  The task is called with the index of the thread that executes it, so that it can use thread-local resources (e.g. its own libint2::Engine)
+ *  If one of the threads throws, the first exception is re-thrown on the calling thread
+ */
+void LibintCommunicator::parallelize(const std::function<void (size_t)>& task) const {
+
+    // The serial path doesn't need to spawn any threads
+    if (this->number_of_threads == 1) {
+        task(0);
+        return;
+    }
+
+
+    std::vector<std::thread> threads;
+    std::vector<std::exception_ptr> exceptions (this->number_of_threads, nullptr);
+
+    for (size_t thread_index = 0; thread_index < this->number_of_threads; thread_index++) {
+        threads.emplace_back([&task, &exceptions, thread_index] () {
+            try {
+                task(thread_index);
+            } catch (...) {
+                exceptions[thread_index] = std::current_exception();
+            }
+        });
+    }
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    for (const auto& exception : exceptions) {
+        if (exception) {
+            std::rethrow_exception(exception);
+        }
+    }
+}
+
+
+
+/**
+ *  @return the number of components (i.e. matrices) that libint2 calculates for the given @param operator_type
+ */
+size_t LibintCommunicator::numberOfComponents(libint2::Operator operator_type) {
+
+    switch (operator_type) {
+        case libint2::Operator::emultipole1: {  // overlap and dipole (x, y, z)
+            return 4;
+        }
+
+        case libint2::Operator::emultipole2: {  // emultipole1 and quadrupole (xx, xy, xz, yy, yz, zz)
+            return 10;
+        }
+
+        case libint2::Operator::emultipole3: {  // emultipole2 and octupole
+            return 20;
+        }
+
+        default: {
+            return 1;
+        }
+    }
+}
+
+
+/**
+ *  @return the indices of the shells in the given @param basisset, sorted by their (l, nprim) class
+ *
+ *  The sort is stable, so shells in the same class keep their relative order
+ */
+std::vector<size_t> LibintCommunicator::sortedShellOrder(const libint2::BasisSet& basisset) {
+
+    std::vector<size_t> shell_order (basisset.size());
+    for (size_t sh = 0; sh < shell_order.size(); sh++) {
+        shell_order[sh] = sh;
+    }
+
+    std::stable_sort(shell_order.begin(), shell_order.end(), [&basisset] (size_t sh1, size_t sh2) {
+        const auto& shell1 = basisset[sh1];
+        const auto& shell2 = basisset[sh2];
+
+        return std::make_pair(shell1.contr[0].l, shell1.nprim()) < std::make_pair(shell2.contr[0].l, shell2.nprim());
+    });
+
+    return shell_order;
+}
+
+
+/**
+ *  @return the indices (i1, i2), with i1 >= i2, that correspond to the compound pair index @param i12 = i1 (i1 + 1) / 2 + i2
+ *
+ *  i1 is the largest integer with i1 (i1 + 1) / 2 <= i12, i.e. floor((sqrt(8 i12 + 1) - 1) / 2). The floating point
+ *  square root can be off by one for large i12, which is corrected afterwards
+ */
+std::pair<size_t, size_t> LibintCommunicator::unpairIndex(size_t i12) {
+
+    auto i1 = static_cast<size_t>((std::sqrt(8.0 * static_cast<double>(i12) + 1.0) - 1.0) / 2.0);
+    if (i1 * (i1 + 1) / 2 > i12) {
+        i1--;
+    } else if ((i1 + 1) * (i1 + 2) / 2 <= i12) {
+        i1++;
+    }
+
+    return std::make_pair(i1, i12 - i1 * (i1 + 1) / 2);
+}
+
+
+/**
+ *  @return an estimate for the overlap of the given shells @param shell1 and @param shell2: the largest Gaussian product
+ *  prefactor exp(-a b / (a + b) |A - B|^2) over their primitives
+ */
+double LibintCommunicator::estimatePrimitiveOverlap(const libint2::Shell& shell1, const libint2::Shell& shell2) {
+
+    double distance_squared = 0.0;
+    for (size_t i = 0; i < 3; i++) {
+        distance_squared += (shell1.O[i] - shell2.O[i]) * (shell1.O[i] - shell2.O[i]);
+    }
+
+    double estimate = 0.0;
+    for (const auto& alpha1 : shell1.alpha) {
+        for (const auto& alpha2 : shell2.alpha) {
+            estimate = std::max(estimate, std::exp(-alpha1 * alpha2 / (alpha1 + alpha2) * distance_squared));
+        }
+    }
+
+    return estimate;
+}
+
 
 /*
  *  PUBLIC METHODS
@@ -42,6 +187,62 @@ LibintCommunicator& LibintCommunicator::get() {  // need to return by reference
 }
 
 
+/**
+ *  Set the number of threads that are used to calculate integrals to @param number_of_threads
+ */
+void LibintCommunicator::set_number_of_threads(size_t number_of_threads) {
+
+    if (number_of_threads == 0) {
+        throw std::invalid_argument("The number of threads should be at least 1.");
+    }
+
+    this->number_of_threads = number_of_threads;
+}
+
+
+/**
+ *  Set the threshold for the Cauchy-Schwarz screening of the two-electron integrals to @param schwarz_threshold
+ */
+void LibintCommunicator::set_schwarz_threshold(double schwarz_threshold) {
+
+    if (schwarz_threshold < 0.0) {
+        throw std::invalid_argument("The Schwarz threshold can't be negative.");
+    }
+
+    this->schwarz_threshold = schwarz_threshold;
+}
+
+
+/**
+ *  Set the target accuracy of the integrals to @param accuracy, which is used as both the precision of every
+ *  libint2::Engine and the Schwarz threshold
+ */
+void LibintCommunicator::set_accuracy(double accuracy) {
+
+    if (accuracy <= 0.0) {
+        throw std::invalid_argument("The target accuracy should be positive.");
+    }
+
+    this->accuracy = accuracy;
+    this->schwarz_threshold = accuracy;
+}
+
+
+/**
+ *  @return a lease on a (possibly reused) libint2::Engine for the given @param operator_type, @param max_nprim,
+ *  @param max_l and @param deriv_order, that is returned to the engine pool when it goes out of scope
+ *
+ *  The precision of the engine is set to @member accuracy
+ */
+GQCG::EnginePool::Lease LibintCommunicator::checkoutEngine(libint2::Operator operator_type, size_t max_nprim, int max_l, int deriv_order) const {
+
+    auto engine = this->engine_pool.checkout(operator_type, max_nprim, max_l, deriv_order);
+    engine->set_precision(this->accuracy);  // a reused engine keeps the precision that was last set on it
+
+    return engine;
+}
+
+
 /**
  *  @return a std::vector<libint2::Atom> based on a given std::vector<GQCG::Atom> @param atoms
  */
@@ -58,153 +259,1064 @@ std::vector<libint2::Atom> LibintCommunicator::interface(const std::vector<GQCG:
 }
 
 
+/**
+ *  @return the Schwarz bounds sqrt(max|(ab|ab)|) for every pair of shells a and b in the given @param basisset, where
+ *  the maximum is taken over all the basis functions in the shells
+ */
+Eigen::MatrixXd LibintCommunicator::calculateSchwarzBounds(const libint2::BasisSet& basisset) const {
+
+    const auto nsh = static_cast<size_t>(basisset.size());  // nsh: number of shells in the basisset
+    Eigen::MatrixXd schwarz_bounds = Eigen::MatrixXd::Zero(nsh, nsh);
+
+
+    // Check out a libint2 engine
+    auto engine = this->checkoutEngine(libint2::Operator::coulomb, basisset.max_nprim(), static_cast<int>(basisset.max_l()));
+    const auto& buffer = engine->results();
+
+
+    // The Schwarz bounds are symmetric, so we only have to calculate the shell pairs with sh1 >= sh2
+    for (size_t sh1 = 0; sh1 < nsh; sh1++) {
+        for (size_t sh2 = 0; sh2 <= sh1; sh2++) {
+            engine->compute(basisset[sh1], basisset[sh2], basisset[sh1], basisset[sh2]);
+
+            auto calculated_integrals = buffer[0];
+            if (calculated_integrals == nullptr) {  // all the integrals are negligible, so the bound stays zero
+                continue;
+            }
+
+            auto number_of_integrals = basisset[sh1].size() * basisset[sh2].size() * basisset[sh1].size() * basisset[sh2].size();
+            double max_integral = 0.0;
+            for (size_t i = 0; i < number_of_integrals; i++) {
+                max_integral = std::max(max_integral, std::abs(calculated_integrals[i]));
+            }
+
+            schwarz_bounds(sh1, sh2) = std::sqrt(max_integral);
+            schwarz_bounds(sh2, sh1) = schwarz_bounds(sh1, sh2);
+        }
+    }
+
+    return schwarz_bounds;
+}
+
+
 /**
  *  @return the OneElectronOperator corresponding to the matrix representation of @param operator_type in the given
  *  @param ao_basis
  */
 GQCG::OneElectronOperator LibintCommunicator::calculateOneElectronIntegrals(libint2::Operator operator_type, const GQCG::AOBasis& ao_basis) const {
 
+    return this->calculateOneElectronIntegrals(std::vector<libint2::Operator> {operator_type}, ao_basis)[0];
+}
+
+
+/**
+ *  @return the OneElectronOperators corresponding to the matrix representations of all the given @param operator_types
+ *  in the given @param ao_basis
+ */
+std::vector<GQCG::OneElectronOperator> LibintCommunicator::calculateOneElectronIntegrals(const std::vector<libint2::Operator>& operator_types, const GQCG::AOBasis& ao_basis, GQCG::OneElectronStorage storage, double overlap_threshold) const {
+
     // Use the basis_functions that is currently a libint2::BasisSet
-    auto libint_basisset = ao_basis.basis_functions;
+    const auto& libint_basisset = ao_basis.basis_functions;
     const auto nbf = static_cast<size_t>(libint_basisset.nbf());  // nbf: number of basis functions in the basisset
 
-    Eigen::MatrixXd matrix = Eigen::MatrixXd::Zero(nbf, nbf);
 
-
-    // Construct the libint2 engine
-    libint2::Engine engine (operator_type, libint_basisset.max_nprim(), static_cast<int>(libint_basisset.max_l()));
+    // Find the matrix that holds the first component of every operator
+    std::vector<size_t> first_component;
+    size_t number_of_components = 0;
+    for (const auto& operator_type : operator_types) {
+        first_component.push_back(number_of_components);
+        number_of_components += LibintCommunicator::numberOfComponents(operator_type);
+    }
 
     // Something extra for the nuclear attraction integrals
-    if (operator_type == libint2::Operator::nuclear) {
-        auto atoms = this->interface(ao_basis.atoms);  // convert from GQCG::Atoms to libint2::atoms
-        engine.set_params(make_point_charges(atoms));
+    auto point_charges = make_point_charges(this->interface(ao_basis.atoms));  // convert from GQCG::Atoms to libint2::atoms
+
+    // The dense matrices are filled in directly, the sparse ones are assembled from the (non-zero) elements that every thread finds
+    std::vector<Eigen::MatrixXd> matrices;
+    std::vector<std::vector<std::vector<Eigen::Triplet<double>>>> elements;  // for every thread and every component
+    if (storage == GQCG::OneElectronStorage::dense) {
+        matrices.assign(number_of_components, Eigen::MatrixXd::Zero(nbf, nbf));
+    } else {
+        elements.assign(this->number_of_threads, std::vector<std::vector<Eigen::Triplet<double>>>(number_of_components));
     }
 
 
     const auto shell2bf = libint_basisset.shell2bf();  // maps shell index to bf index
 
-    const auto& buffer = engine.results();  // vector that holds pointers to computed shell sets
-    // actually, buffer.size() is always 1, so buffer[0] is a pointer to
-    //      the first calculated integral of these specific shells
-    // the values that buffer[0] points to will change after every compute() call
-
 
     // One-electron integrals are between two basis functions, so we'll need two loops
     // Libint calculates integrals between libint2::Shells, so we will loop over the shells (sh) in the basisset
+    // The one-electron operators are symmetric, so we only calculate the unique shell pairs and mirror their integrals.
+    // Every shell pair is visited once, for all the operators together, in an order that is sorted by the (l, nprim) class of the shells
+    // The shell pairs are handed out dynamically to the threads, so that shells with different angular momenta are load-balanced
+    // Shell pairs whose primitive overlap estimate is smaller than the overlap threshold are skipped
     const auto nsh = static_cast<size_t>(libint_basisset.size());  // nsh: number of shells in the basisset
-    for (auto sh1 = 0; sh1 != nsh; ++sh1) {  // sh1: shell 1
-        for (auto sh2 = 0; sh2 != nsh; ++sh2) {  // sh2: shell 2
-            // Calculate integrals between the two shells (basis_set is a decorated std::vector<libint2::Shell>)
-            engine.compute(libint_basisset[sh1], libint_basisset[sh2]);
+    const auto number_of_shell_pairs = nsh * (nsh + 1) / 2;
+    const auto shell_order = LibintCommunicator::sortedShellOrder(libint_basisset);
+    std::atomic<size_t> next_shell_pair (0);
 
-            auto calculated_integrals = buffer[0];  // is actually a pointer: const double *
+    this->parallelize([&] (size_t thread) {
 
-            if (calculated_integrals == nullptr) {  // if the zeroth element is nullptr, then the whole shell has been exhausted
-                // or the libint engine predicts that the integrals are below a certain threshold
-                // in this case the value does not need to be filled in, and we are safe because we have properly initialized to zero
-                continue;
+        // Every thread needs its own engines, so it checks them out of the engine pool
+        std::vector<GQCG::EnginePool::Lease> thread_engines;
+        for (const auto& operator_type : operator_types) {
+            thread_engines.push_back(this->checkoutEngine(operator_type, libint_basisset.max_nprim(), static_cast<int>(libint_basisset.max_l())));
+
+            if (operator_type == libint2::Operator::nuclear) {
+                thread_engines.back()->set_params(point_charges);
+            }
+        }
+
+        for (size_t i12 = next_shell_pair++; i12 < number_of_shell_pairs; i12 = next_shell_pair++) {
+
+            // Find i1 >= i2 that correspond to the compound index i12 = i1 * (i1 + 1) / 2 + i2, in the sorted shell order
+            size_t i1, i2;
+            std::tie(i1, i2) = LibintCommunicator::unpairIndex(i12);
+
+            auto sh1 = shell_order[i1];  // sh1: shell 1
+            auto sh2 = shell_order[i2];  // sh2: shell 2
+
+            if ((overlap_threshold > 0.0) && (LibintCommunicator::estimatePrimitiveOverlap(libint_basisset[sh1], libint_basisset[sh2]) < overlap_threshold)) {
+                continue;  // all the integrals over this shell pair are negligible
             }
 
-            // Extract the calculated integrals from calculated_integrals
-            // In calculated_integrals, the integrals are stored in row major form
             auto bf1 = shell2bf[sh1];  // (index of) first bf in sh1
             auto bf2 = shell2bf[sh2];  // (index of) first bf in sh2
 
             auto nbf_sh1 = libint_basisset[sh1].size();  // number of basis functions in first shell
             auto nbf_sh2 = libint_basisset[sh2].size();  // number of basis functions in second shell
 
-            for (auto f1 = 0; f1 != nbf_sh1; ++f1) {  // f1: index of basis function within shell 1
-                for (auto f2 = 0; f2 != nbf_sh2; ++f2) { // f2: index of basis function within shell 2
-                    double computed_integral = calculated_integrals[f2 + f1 * nbf_sh2];  // integrals are packed in row-major form
-                    matrix(bf1 + f1, bf2 + f2) = computed_integral;
+            for (size_t i = 0; i < thread_engines.size(); i++) {
+
+                // Calculate integrals between the two shells (basis_set is a decorated std::vector<libint2::Shell>)
+                thread_engines[i]->compute(libint_basisset[sh1], libint_basisset[sh2]);
+
+                const auto& buffer = thread_engines[i]->results();  // vector that holds pointers to the computed shell sets of every component of the operator
+                for (size_t component = 0; component < buffer.size(); component++) {
+                    auto calculated_integrals = buffer[component];  // is actually a pointer: const double *
+
+                    if (calculated_integrals == nullptr) {  // if the zeroth element is nullptr, then the whole shell has been exhausted
+                        // or the libint engine predicts that the integrals are below a certain threshold
+                        // in this case the value does not need to be filled in, and we are safe because we have properly initialized to zero
+                        continue;
+                    }
+
+                    // Extract the calculated integrals from calculated_integrals
+                    // In calculated_integrals, the integrals are stored in row major form
+                    auto index = first_component[i] + component;
+                    for (size_t f1 = 0; f1 != nbf_sh1; ++f1) {  // f1: index of basis function within shell 1
+                        for (size_t f2 = 0; f2 != nbf_sh2; ++f2) { // f2: index of basis function within shell 2
+                            double computed_integral = calculated_integrals[f2 + f1 * nbf_sh2];  // integrals are packed in row-major form
+
+                            if (storage == GQCG::OneElectronStorage::dense) {
+                                matrices[index](bf1 + f1, bf2 + f2) = computed_integral;
+                                matrices[index](bf2 + f2, bf1 + f1) = computed_integral;
+                                continue;
+                            }
+
+                            if (computed_integral == 0.0) {
+                                continue;
+                            }
+
+                            elements[thread][index].emplace_back(bf1 + f1, bf2 + f2, computed_integral);
+                            if (sh1 != sh2) {  // the elements of a diagonal shell pair are already all calculated
+                                elements[thread][index].emplace_back(bf2 + f2, bf1 + f1, computed_integral);
+                            }
+                        }
+                    }  // data access loops
                 }
-            }  // data access loops
+            }
+
+        }  // shell pair loop
+    });
 
+
+    std::vector<GQCG::OneElectronOperator> operators;
+    if (storage == GQCG::OneElectronStorage::dense) {
+        for (auto& matrix : matrices) {
+            operators.emplace_back(std::move(matrix));
+        }
+
+        return operators;
+    }
+
+    for (size_t index = 0; index < number_of_components; index++) {
+        std::vector<Eigen::Triplet<double>> component_elements;
+        for (const auto& thread_elements : elements) {
+            component_elements.insert(component_elements.end(), thread_elements[index].begin(), thread_elements[index].end());
         }
-    }  // shell loops
 
-    return GQCG::OneElectronOperator(matrix);
+        Eigen::SparseMatrix<double> sparse_matrix (nbf, nbf);
+        sparse_matrix.setFromTriplets(component_elements.begin(), component_elements.end());
+        operators.emplace_back(std::move(sparse_matrix));
+    }
+
+    return operators;
 }
 
 
 /**
- *  @return the TwoElectronOperator corresponding to the matrix representation of @param operator_type in the given
- *  @param ao_basis
+ *  Calculate the two-electron integrals of @param operator_type in the given @param ao_basis, and call the given
+ *  @param visitor for every calculated (canonical) shell quartet
+ *
+ *  If they are given, the (shell pair) @param density_bounds are also used to screen the shell quartets
  */
-GQCG::TwoElectronOperator LibintCommunicator::calculateTwoElectronIntegrals(libint2::Operator operator_type, const GQCG::AOBasis& ao_basis) const {
+void LibintCommunicator::visitTwoElectronIntegrals(libint2::Operator operator_type, const GQCG::AOBasis& ao_basis, const GQCG::ShellQuartetVisitor& visitor, const Eigen::MatrixXd& density_bounds) const {
 
     // Use the basis_functions that is currently a libint2::BasisSet
-    auto libint_basisset = ao_basis.basis_functions;
-    const auto nbf = static_cast<size_t>(libint_basisset.nbf());  // nbf: number of basis functions in the basisset
-
-
-    // Initialize the rank-4 two-electron integrals tensor and set to zero
-    Eigen::Tensor<double, 4> tensor (nbf, nbf, nbf, nbf);
-    tensor.setZero();
+    const auto& libint_basisset = ao_basis.basis_functions;
 
 
-    // Construct the libint2 engine
-    libint2::Engine engine(libint2::Operator::coulomb, libint_basisset.max_nprim(), static_cast<int>(libint_basisset.max_l()));  // libint2 requires an int
-
     const auto shell2bf = libint_basisset.shell2bf();  // maps shell index to bf index
 
-    const auto &buffer = engine.results();  // vector that holds pointers to computed shell sets
-    // actually, buffer.size() is always 1, so buffer[0] is a pointer to
-    //      the first calculated integral of these specific shells
-    // the values that buffer[0] points to will change after every compute() call
-
 
     // Two-electron integrals are between four basis functions, so we'll need four loops
     // Libint calculates integrals between libint2::Shells, so we will loop over the shells (sh) in the basisset
+    // For real basis functions, the two-electron integrals have an 8-fold permutational symmetry:
+    //      (12|34) = (21|34) = (12|43) = (21|43) = (34|12) = (43|12) = (34|21) = (43|21)
+    // so we only calculate the canonical shell quartets (sh1 >= sh2, sh3 >= sh4, sh12 >= sh34)
+    //
+    // The shells are visited in an order that is sorted by their (l, nprim) class, so that consecutive shell quartets
+    // belong to the same class and libint can keep using the same recurrence code paths. The canonical shell quartets
+    // are defined in this sorted order, and the integrals are scattered to the original basis functions through shell2bf
+    //
+    // The bra shell pairs are handed out dynamically to the threads. Since the number of ket shell pairs grows with
+    // the compound bra index, we hand out the largest (and most expensive) bra shell pairs first
+    //
+    // Shell quartets with a Schwarz bound (possibly multiplied by a density bound) below the threshold are skipped before calling libint
     const auto nsh = static_cast<size_t>(libint_basisset.size());  // nsh: number of shells in the basisset
-    for (auto sh1 = 0; sh1 != nsh; ++sh1) {  // sh1: shell 1
-        for (auto sh2 = 0; sh2 != nsh; ++sh2) {  // sh2: shell 2
-            for (auto sh3 = 0; sh3 != nsh; ++sh3) {  // sh3: shell 3
-                for (auto sh4 = 0; sh4 != nsh; ++sh4) {  //sh4: shell 4
+    const auto number_of_shell_pairs = nsh * (nsh + 1) / 2;
+    const auto shell_order = LibintCommunicator::sortedShellOrder(libint_basisset);
+    std::atomic<size_t> next_shell_pair (0);
+
+    // Integrals that are contracted with a density are always screened, at least with the target accuracy
+    // The Schwarz bounds of the AOBasis are only calculated (once) if the shell quartets are actually screened, and
+    // since they are calculated with the Coulomb operator, only the Coulomb integrals can be screened with them
+    const auto threshold = (density_bounds.size() != 0) ? std::max(this->schwarz_threshold, this->accuracy) : this->schwarz_threshold;
+    const Eigen::MatrixXd* schwarz_bounds = ((operator_type == libint2::Operator::coulomb) && (threshold > 0.0)) ? &ao_basis.get_schwarz_bounds() : nullptr;
+    std::atomic<size_t> screened_quartets (0);
+
+    this->parallelize([&] (size_t thread) {
+
+        // Every thread needs its own engine, so it checks one out of the engine pool
+        auto thread_engine = this->checkoutEngine(operator_type, libint_basisset.max_nprim(), static_cast<int>(libint_basisset.max_l()));  // libint2 requires an int
+        size_t thread_screened_quartets = 0;
+
+        const auto& buffer = thread_engine->results();  // vector that holds pointers to computed shell sets
+        // actually, buffer.size() is always 1, so buffer[0] is a pointer to
+        //      the first calculated integral of these specific shells
+        // the values that buffer[0] points to will change after every compute() call
+
+
+        for (size_t counter = next_shell_pair++; counter < number_of_shell_pairs; counter = next_shell_pair++) {
+            auto i12 = number_of_shell_pairs - 1 - counter;  // compound index of the bra shell pair, in the sorted shell order
+
+            // Find i1 >= i2 that correspond to the compound index i12 = i1 * (i1 + 1) / 2 + i2
+            size_t i1, i2;
+            std::tie(i1, i2) = LibintCommunicator::unpairIndex(i12);
+
+            auto sh1 = shell_order[i1];  // sh1: shell 1
+            auto sh2 = shell_order[i2];  // sh2: shell 2
+
+            for (size_t i3 = 0; i3 <= i1; ++i3) {
+                auto sh3 = shell_order[i3];  // sh3: shell 3
+
+                for (size_t i4 = 0; i4 <= i3; ++i4) {
+                    auto sh4 = shell_order[i4];  // sh4: shell 4
+
+                    auto i34 = i3 * (i3 + 1) / 2 + i4;  // compound index of the ket shell pair, in the sorted shell order
+                    if (i34 > i12) {  // this shell quartet is the permutation of a canonical one
+                        break;
+                    }
+
+                    if (schwarz_bounds != nullptr) {
+                        double bound = (*schwarz_bounds)(sh1, sh2) * (*schwarz_bounds)(sh3, sh4);
+                        if (density_bounds.size() != 0) {  // the integrals are contracted with a density
+                            bound *= std::max({density_bounds(sh1, sh2), density_bounds(sh3, sh4),
+                                               density_bounds(sh1, sh3), density_bounds(sh1, sh4),
+                                               density_bounds(sh2, sh3), density_bounds(sh2, sh4)});
+                        }
+
+                        if (bound < threshold) {  // all (contracted) integrals in this shell quartet are negligible
+                            thread_screened_quartets++;
+                            continue;
+                        }
+                    }
+
                     // Calculate integrals between the two shells (obs is a decorated std::vector<libint2::Shell>)
-                    engine.compute(libint_basisset[sh1], libint_basisset[sh2], libint_basisset[sh3], libint_basisset[sh4]);
+                    thread_engine->compute(libint_basisset[sh1], libint_basisset[sh2], libint_basisset[sh3], libint_basisset[sh4]);
 
                     auto calculated_integrals = buffer[0];
 
                     if (calculated_integrals == nullptr) {  // if the zeroth element is nullptr, then the whole shell has been exhausted
                         // or the libint engine predicts that the integrals are below a certain threshold
-                        // in this case the value does not need to be filled in, and we are safe because we have properly initialized to zero
+                        // in this case there is nothing to visit
                         continue;
                     }
 
-                    // Extract the calculated integrals from calculated_integrals.
-                    // In calculated_integrals, the integrals are stored in row major form.
-                    auto bf1 = static_cast<long>(shell2bf[sh1]);  // (index of) first bf in sh1
-                    auto bf2 = static_cast<long>(shell2bf[sh2]);  // (index of) first bf in sh2
-                    auto bf3 = static_cast<long>(shell2bf[sh3]);  // (index of) first bf in sh3
-                    auto bf4 = static_cast<long>(shell2bf[sh4]);  // (index of) first bf in sh4
+                    GQCG::ShellQuartetBlock block;
+                    block.shells = {sh1, sh2, sh3, sh4};
+                    block.first_bf = {shell2bf[sh1], shell2bf[sh2], shell2bf[sh3], shell2bf[sh4]};
+                    block.nbf = {libint_basisset[sh1].size(), libint_basisset[sh2].size(), libint_basisset[sh3].size(), libint_basisset[sh4].size()};
+                    block.integrals = calculated_integrals;
 
+                    visitor(block, thread);
+                }
+            }
+        }  // shell loops
 
-                    auto nbf_sh1 = static_cast<long>(libint_basisset[sh1].size());  // number of basis functions in first shell
-                    auto nbf_sh2 = static_cast<long>(libint_basisset[sh2].size());  // number of basis functions in second shell
-                    auto nbf_sh3 = static_cast<long>(libint_basisset[sh3].size());  // number of basis functions in third shell
-                    auto nbf_sh4 = static_cast<long>(libint_basisset[sh4].size());  // number of basis functions in fourth shell
+        screened_quartets += thread_screened_quartets;
+    });
 
-                    for (auto f1 = 0L; f1 != nbf_sh1; ++f1) {
-                        for (auto f2 = 0L; f2 != nbf_sh2; ++f2) {
-                            for (auto f3 = 0L; f3 != nbf_sh3; ++f3) {
-                                for (auto f4 = 0L; f4 != nbf_sh4; ++f4) {
-                                    auto computed_integral = calculated_integrals[f4 + nbf_sh4 * (f3 + nbf_sh3 * (f2 + nbf_sh2 * (f1)))];  // integrals are packed in row-major form
+    this->number_of_screened_quartets = screened_quartets.load();
+}
 
-                                    // Two-electron integrals are given in CHEMIST'S notation: (11|22)
-                                    tensor(f1 + bf1, f2 + bf2, f3 + bf3, f4 + bf4) = computed_integral;
-                                }
+
+/**
+ *  @return the TwoElectronOperator corresponding to the matrix representation of @param operator_type in the given
+ *  @param ao_basis, in the given @param storage
+ */
+GQCG::TwoElectronOperator LibintCommunicator::calculateTwoElectronIntegrals(libint2::Operator operator_type, const GQCG::AOBasis& ao_basis, GQCG::TwoElectronStorage storage) const {
+
+    if (storage == GQCG::TwoElectronStorage::factorized) {
+        throw std::invalid_argument("The factorized storage is obtained through calculateCholeskyDecomposedTwoElectronIntegrals.");
+    }
+
+
+    const auto nbf = static_cast<size_t>(ao_basis.basis_functions.nbf());  // nbf: number of basis functions in the basisset
+
+
+    // Initialize the rank-4 two-electron integrals tensor (or its packed symmetry-unique elements), whose elements are calculated in place
+    // The mixed storage is compressed from the packed one afterwards
+    auto g = (storage == GQCG::TwoElectronStorage::dense) ? GQCG::TwoElectronOperator(Eigen::Tensor<double, 4> (nbf, nbf, nbf, nbf)) : GQCG::TwoElectronOperator(Eigen::VectorXd(GQCG::TwoElectronOperator::numberOfPackedElements(nbf)), nbf);
+    this->recalculateTwoElectronIntegrals(operator_type, ao_basis, g);
+
+    if (storage == GQCG::TwoElectronStorage::mixed) {
+        g.compress();
+    }
+
+    return g;
+}
+
+
+/**
+ *  Recalculate the matrix representation of @param operator_type in the given @param ao_basis into the given
+ *  two-electron operator @param g, in its current (dense or packed) storage
+ *
+ *  The memory of @param g is reused if its dimension is already the number of basis functions
+ */
+void LibintCommunicator::recalculateTwoElectronIntegrals(libint2::Operator operator_type, const GQCG::AOBasis& ao_basis, GQCG::TwoElectronOperator& g) const {
+
+    const auto storage = g.get_storage();
+    if ((storage != GQCG::TwoElectronStorage::dense) && (storage != GQCG::TwoElectronStorage::packed)) {
+        throw std::invalid_argument("The two-electron integrals can only be recalculated in the dense or packed storage.");
+    }
+
+
+    const auto nbf = static_cast<size_t>(ao_basis.basis_functions.nbf());  // nbf: number of basis functions in the basisset
+
+
+    // Resize the rank-4 two-electron integrals tensor (or its packed symmetry-unique elements) only if needed, and set to zero
+    auto& tensor = g.tensor;
+    auto& packed_elements = g.packed_elements;
+    if (storage == GQCG::TwoElectronStorage::dense) {
+        if (g.dim != nbf) {
+            tensor.resize(nbf, nbf, nbf, nbf);
+        }
+        tensor.setZero();
+    } else {
+        packed_elements.resize(GQCG::TwoElectronOperator::numberOfPackedElements(nbf));  // a no-op if the size doesn't change
+        packed_elements.setZero();
+    }
+    g.dim = nbf;
+
+
+    // Every canonical shell quartet writes to its own, distinct elements in the tensor, so the threads never write to
+    // the same element and the result doesn't depend on the number of threads
+    this->visitTwoElectronIntegrals(operator_type, ao_basis, [&] (const GQCG::ShellQuartetBlock& block, size_t) {
+
+        for (size_t f1 = 0; f1 != block.nbf[0]; ++f1) {
+            for (size_t f2 = 0; f2 != block.nbf[1]; ++f2) {
+                for (size_t f3 = 0; f3 != block.nbf[2]; ++f3) {
+                    for (size_t f4 = 0; f4 != block.nbf[3]; ++f4) {
+                        auto computed_integral = block(f1, f2, f3, f4);
+
+                        // Two-electron integrals are given in CHEMIST'S notation: (11|22)
+                        auto p = static_cast<long>(f1 + block.first_bf[0]);
+                        auto q = static_cast<long>(f2 + block.first_bf[1]);
+                        auto r = static_cast<long>(f3 + block.first_bf[2]);
+                        auto s = static_cast<long>(f4 + block.first_bf[3]);
+
+                        if (storage != GQCG::TwoElectronStorage::dense) {  // only the symmetry-unique element has to be stored
+                            packed_elements(GQCG::TwoElectronOperator::packedIndex(p, q, r, s)) = computed_integral;
+                            continue;
+                        }
+
+                        // Scatter the integral to all its symmetry-equivalent positions
+                        tensor(p, q, r, s) = computed_integral;
+                        tensor(q, p, r, s) = computed_integral;
+                        tensor(p, q, s, r) = computed_integral;
+                        tensor(q, p, s, r) = computed_integral;
+                        tensor(r, s, p, q) = computed_integral;
+                        tensor(s, r, p, q) = computed_integral;
+                        tensor(r, s, q, p) = computed_integral;
+                        tensor(s, r, q, p) = computed_integral;
+                    }
+                }
+            }
+        } // data access loops
+    });
+}
+
+
+/**
+ *  @return the Coulomb matrices J_pq = sum_rs (pq|rs) D_rs (first) and the exchange matrices K_pr = sum_qs (pq|rs) D_qs
+ *  (second) for every one of the given symmetric @param densities in the given @param ao_basis
+ */
+std::pair<std::vector<GQCG::OneElectronOperator>, std::vector<GQCG::OneElectronOperator>> LibintCommunicator::calculateCoulombAndExchangeMatrices(const std::vector<Eigen::MatrixXd>& densities, const GQCG::AOBasis& ao_basis) const {
+
+    const auto& libint_basisset = ao_basis.basis_functions;
+    const auto nbf = static_cast<long>(libint_basisset.nbf());  // nbf: number of basis functions in the basisset
+    const auto nsh = static_cast<size_t>(libint_basisset.size());  // nsh: number of shells in the basisset
+    const auto number_of_densities = densities.size();
+
+    for (const auto& D : densities) {
+        if ((D.rows() != nbf) || (D.cols() != nbf)) {
+            throw std::invalid_argument("The dimensions of the densities are not compatible with the given AO basis.");
+        }
+    }
+
+
+    // Find the largest density element (over all densities) for every shell pair, to be used in the screening
+    const auto shell2bf = libint_basisset.shell2bf();  // maps shell index to bf index
+
+    Eigen::MatrixXd density_bounds = Eigen::MatrixXd::Zero(nsh, nsh);
+    for (size_t sh1 = 0; sh1 < nsh; sh1++) {
+        for (size_t sh2 = 0; sh2 < nsh; sh2++) {
+            auto nbf_sh1 = static_cast<long>(libint_basisset[sh1].size());
+            auto nbf_sh2 = static_cast<long>(libint_basisset[sh2].size());
+
+            for (const auto& D : densities) {
+                double bound = D.block(shell2bf[sh1], shell2bf[sh2], nbf_sh1, nbf_sh2).cwiseAbs().maxCoeff();
+                density_bounds(sh1, sh2) = std::max(density_bounds(sh1, sh2), bound);
+            }
+        }
+    }
+
+
+    // Every thread accumulates its own (unsymmetrized) contributions G_J and G_K to J and K
+    // Following the libint2 Hartree-Fock example, we visit only the canonical shell quartets, multiply every integral by
+    // the degeneracy of its shell quartet, and symmetrize afterwards
+    std::vector<std::vector<Eigen::MatrixXd>> G_J (this->number_of_threads, std::vector<Eigen::MatrixXd>(number_of_densities, Eigen::MatrixXd::Zero(nbf, nbf)));
+    std::vector<std::vector<Eigen::MatrixXd>> G_K (this->number_of_threads, std::vector<Eigen::MatrixXd>(number_of_densities, Eigen::MatrixXd::Zero(nbf, nbf)));
+
+    this->visitTwoElectronIntegrals(libint2::Operator::coulomb, ao_basis, [&] (const GQCG::ShellQuartetBlock& block, size_t thread) {
+
+        const auto degeneracy = block.degeneracy();
+
+        for (size_t f1 = 0; f1 != block.nbf[0]; ++f1) {
+            for (size_t f2 = 0; f2 != block.nbf[1]; ++f2) {
+                for (size_t f3 = 0; f3 != block.nbf[2]; ++f3) {
+                    for (size_t f4 = 0; f4 != block.nbf[3]; ++f4) {
+                        auto value = block(f1, f2, f3, f4) * degeneracy;
+
+                        auto p = static_cast<long>(f1 + block.first_bf[0]);
+                        auto q = static_cast<long>(f2 + block.first_bf[1]);
+                        auto r = static_cast<long>(f3 + block.first_bf[2]);
+                        auto s = static_cast<long>(f4 + block.first_bf[3]);
+
+                        for (size_t i = 0; i < number_of_densities; i++) {
+                            const auto& D = densities[i];
+                            auto& J = G_J[thread][i];
+                            auto& K = G_K[thread][i];
+
+                            J(p, q) += D(r, s) * value;
+                            J(r, s) += D(p, q) * value;
+
+                            K(p, r) += D(q, s) * value;
+                            K(q, s) += D(p, r) * value;
+                            K(p, s) += D(q, r) * value;
+                            K(q, r) += D(p, s) * value;
+                        }
+                    }
+                }
+            }
+        }  // data access loops
+    }, density_bounds);
+
+
+    // Sum the contributions of the threads and symmetrize
+    std::vector<GQCG::OneElectronOperator> coulomb_matrices;
+    std::vector<GQCG::OneElectronOperator> exchange_matrices;
+    for (size_t i = 0; i < number_of_densities; i++) {
+        Eigen::MatrixXd J = Eigen::MatrixXd::Zero(nbf, nbf);
+        Eigen::MatrixXd K = Eigen::MatrixXd::Zero(nbf, nbf);
+        for (size_t thread = 0; thread < this->number_of_threads; thread++) {
+            J += G_J[thread][i];
+            K += G_K[thread][i];
+        }
+
+        coulomb_matrices.emplace_back(0.25 * (J + J.transpose()));
+        exchange_matrices.emplace_back(0.125 * (K + K.transpose()));
+    }
+
+    return std::make_pair(coulomb_matrices, exchange_matrices);
+}
+
+
+/**
+ *  @return the TwoElectronOperator, in the factorized storage, corresponding to a pivoted Cholesky decomposition of the
+ *  matrix representation of @param operator_type in the given @param ao_basis
+ *
+ *  The Cholesky vectors are added until every diagonal element (pq|pq) is reproduced within the given @param tolerance,
+ *  which also bounds the error on every element: |(pq|rs) - sum_L L^L_pq L^L_rs| <= @param tolerance
+ */
+GQCG::TwoElectronOperator LibintCommunicator::calculateCholeskyDecomposedTwoElectronIntegrals(libint2::Operator operator_type, const GQCG::AOBasis& ao_basis, double tolerance) const {
+
+    if (tolerance <= 0.0) {
+        throw std::invalid_argument("The tolerance for the Cholesky decomposition should be positive.");
+    }
+
+
+    // Use the basis_functions that is currently a libint2::BasisSet
+    const auto& libint_basisset = ao_basis.basis_functions;
+    const auto nbf = static_cast<size_t>(libint_basisset.nbf());  // nbf: number of basis functions in the basisset
+    const auto nsh = static_cast<size_t>(libint_basisset.size());  // nsh: number of shells in the basisset
+
+    if (nbf == 0) {  // there are no integrals to decompose
+        return GQCG::TwoElectronOperator(Eigen::MatrixXd(0, 0));
+    }
+
+    const auto shell2bf = libint_basisset.shell2bf();  // maps shell index to bf index
+
+    // Find the shell of every basis function, to be able to find the shell pair of a pivot
+    std::vector<size_t> bf2shell (nbf);
+    for (size_t sh = 0; sh < nsh; sh++) {
+        for (size_t f = 0; f < libint_basisset[sh].size(); f++) {
+            bf2shell[shell2bf[sh] + f] = sh;
+        }
+    }
+
+
+    // Check out a libint2 engine
+    auto engine = this->checkoutEngine(operator_type, libint_basisset.max_nprim(), static_cast<int>(libint_basisset.max_l()));
+    const auto& buffer = engine->results();
+
+
+    // The rows of the Cholesky vectors (and the diagonal) are the compound indices pq = p + nbf * q
+    // 1) Calculate the diagonal (pq|pq) from the shell quartets (ab|ab)
+    // For the Coulomb operator, the cached Schwarz bounds sqrt(max|(ab|ab)|) of the AOBasis are reused: the diagonal
+    // elements of a shell pair whose squared bound is below the tolerance can never become a pivot, so they are left zero
+    const Eigen::MatrixXd* schwarz_bounds = (operator_type == libint2::Operator::coulomb) ? &ao_basis.get_schwarz_bounds() : nullptr;
+
+    Eigen::VectorXd diagonal = Eigen::VectorXd::Zero(nbf * nbf);
+    for (size_t sh1 = 0; sh1 < nsh; sh1++) {
+        for (size_t sh2 = 0; sh2 <= sh1; sh2++) {
+            if ((schwarz_bounds != nullptr) && ((*schwarz_bounds)(sh1, sh2) * (*schwarz_bounds)(sh1, sh2) <= tolerance)) {
+                continue;
+            }
+
+            engine->compute(libint_basisset[sh1], libint_basisset[sh2], libint_basisset[sh1], libint_basisset[sh2]);
+
+            auto calculated_integrals = buffer[0];
+            if (calculated_integrals == nullptr) {
+                continue;
+            }
+
+            auto nbf_sh1 = libint_basisset[sh1].size();
+            auto nbf_sh2 = libint_basisset[sh2].size();
+            for (size_t f1 = 0; f1 < nbf_sh1; f1++) {
+                for (size_t f2 = 0; f2 < nbf_sh2; f2++) {
+                    auto p = shell2bf[sh1] + f1;
+                    auto q = shell2bf[sh2] + f2;
+
+                    // (f1 f2|f1 f2) is packed in row-major form
+                    double integral = calculated_integrals[f2 + nbf_sh2 * (f1 + nbf_sh1 * (f2 + nbf_sh2 * f1))];
+                    diagonal(p + nbf * q) = integral;
+                    diagonal(q + nbf * p) = integral;
+                }
+            }
+        }
+    }
+
+
+    // 2) Add Cholesky vectors until the largest remaining diagonal element is below the tolerance
+    // Every iteration calculates the integral columns (rs|ab) for the shell pair (a,b) that contains the largest diagonal
+    // element, and uses as many pivots from that shell pair as possible
+    Eigen::MatrixXd factors (nbf * nbf, nbf);  // the capacity is increased when needed
+    size_t number_of_factors = 0;
+
+    Eigen::Index pivot;
+    while (diagonal.maxCoeff(&pivot) > tolerance) {
+
+        auto sh_a = bf2shell[pivot % nbf];
+        auto sh_b = bf2shell[pivot / nbf];
+        auto bf_a = shell2bf[sh_a];
+        auto bf_b = shell2bf[sh_b];
+        auto nbf_a = libint_basisset[sh_a].size();
+        auto nbf_b = libint_basisset[sh_b].size();
+
+
+        // Calculate the integral columns (rs|ab) for all pairs rs and all basis function pairs ab in the pivot shell pair
+        Eigen::MatrixXd columns = Eigen::MatrixXd::Zero(nbf * nbf, nbf_a * nbf_b);  // column index: fa + nbf_a * fb
+        for (size_t sh3 = 0; sh3 < nsh; sh3++) {
+            for (size_t sh4 = 0; sh4 <= sh3; sh4++) {
+                engine->compute(libint_basisset[sh3], libint_basisset[sh4], libint_basisset[sh_a], libint_basisset[sh_b]);
+
+                auto calculated_integrals = buffer[0];
+                if (calculated_integrals == nullptr) {
+                    continue;
+                }
+
+                auto nbf_sh3 = libint_basisset[sh3].size();
+                auto nbf_sh4 = libint_basisset[sh4].size();
+                for (size_t f3 = 0; f3 < nbf_sh3; f3++) {
+                    for (size_t f4 = 0; f4 < nbf_sh4; f4++) {
+                        auto r = shell2bf[sh3] + f3;
+                        auto s = shell2bf[sh4] + f4;
+
+                        for (size_t fa = 0; fa < nbf_a; fa++) {
+                            for (size_t fb = 0; fb < nbf_b; fb++) {
+                                double integral = calculated_integrals[fb + nbf_b * (fa + nbf_a * (f4 + nbf_sh4 * f3))];  // integrals are packed in row-major form
+                                columns(r + nbf * s, fa + nbf_a * fb) = integral;
+                                columns(s + nbf * r, fa + nbf_a * fb) = integral;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+
+        // Use the pivots in this shell pair, from large to small, as long as they are above the tolerance
+        while (true) {
+            size_t best_column = 0;
+            double best_diagonal = 0.0;
+            for (size_t fa = 0; fa < nbf_a; fa++) {
+                for (size_t fb = 0; fb < nbf_b; fb++) {
+                    auto d = diagonal(bf_a + fa + nbf * (bf_b + fb));
+                    if (d > best_diagonal) {
+                        best_diagonal = d;
+                        best_column = fa + nbf_a * fb;
+                    }
+                }
+            }
+
+            if (best_diagonal <= tolerance) {
+                break;
+            }
+
+            auto pq = bf_a + best_column % nbf_a + nbf * (bf_b + best_column / nbf_a);  // the compound index of the pivot
+
+
+            // Increase the capacity if needed
+            if (number_of_factors == static_cast<size_t>(factors.cols())) {
+                factors.conservativeResize(Eigen::NoChange, 2 * factors.cols());
+            }
+
+
+            // L_new = ((rs|pq) - sum_L L^L_rs L^L_pq) / sqrt(D_pq)
+            auto new_factor = factors.col(number_of_factors);
+            new_factor = columns.col(best_column);
+            if (number_of_factors > 0) {
+                new_factor.noalias() -= factors.leftCols(number_of_factors) * factors.block(pq, 0, 1, number_of_factors).transpose();
+            }
+            new_factor /= std::sqrt(best_diagonal);
+            number_of_factors++;
+
+
+            // Update the remaining diagonal, guarding against small negative values due to round-off errors
+            diagonal -= new_factor.cwiseAbs2();
+            diagonal = diagonal.cwiseMax(0.0);
+            diagonal(pq) = 0.0;
+        }
+    }
+
+    factors.conservativeResize(Eigen::NoChange, number_of_factors);
+
+    return GQCG::TwoElectronOperator(std::move(factors));
+}
+
+
+/**
+ *  @return the TwoElectronOperator, in the factorized storage, corresponding to the density-fitted (resolution of the
+ *  identity) Coulomb integrals in the given @param ao_basis, using the given @param auxiliary_basis
+ *
+ *  The factors are the fitted three-center integrals
+ *      B^P_pq = sum_Q (P|Q)^(-1/2) (Q|pq) ,
+ *  such that (pq|rs) ~ sum_P B^P_pq B^P_rs
+ */
+GQCG::TwoElectronOperator LibintCommunicator::calculateDensityFittedIntegrals(const GQCG::AOBasis& ao_basis, const GQCG::AOBasis& auxiliary_basis) const {
+
+    const auto& libint_basisset = ao_basis.basis_functions;
+    const auto& auxiliary_basisset = auxiliary_basis.basis_functions;
+
+    const auto nbf = static_cast<size_t>(libint_basisset.nbf());  // nbf: number of basis functions in the basisset
+    const auto naux = static_cast<size_t>(auxiliary_basisset.nbf());  // naux: number of basis functions in the auxiliary basisset
+    const auto nsh = static_cast<size_t>(libint_basisset.size());
+    const auto nsh_aux = static_cast<size_t>(auxiliary_basisset.size());
+
+    const auto shell2bf = libint_basisset.shell2bf();
+    const auto shell2bf_aux = auxiliary_basisset.shell2bf();
+
+
+    // The libint2 engine should be able to handle both basissets
+    auto max_nprim = std::max(libint_basisset.max_nprim(), auxiliary_basisset.max_nprim());
+    auto max_l = std::max(static_cast<int>(libint_basisset.max_l()), static_cast<int>(auxiliary_basisset.max_l()));
+    const auto& unit_shell = libint2::Shell::unit();  // the three- and two-center integrals are four-center integrals with unit shells
+
+
+    // 1) Calculate the two-center integrals (P|Q)
+    Eigen::MatrixXd metric = Eigen::MatrixXd::Zero(naux, naux);
+
+    libint2::Engine two_center_engine (libint2::Operator::coulomb, max_nprim, max_l, 0, this->accuracy);
+    two_center_engine.set(libint2::BraKet::xs_xs);
+    const auto& two_center_buffer = two_center_engine.results();
+
+    for (size_t sh1 = 0; sh1 < nsh_aux; sh1++) {
+        for (size_t sh2 = 0; sh2 <= sh1; sh2++) {
+            two_center_engine.compute(auxiliary_basisset[sh1], unit_shell, auxiliary_basisset[sh2], unit_shell);
+
+            auto calculated_integrals = two_center_buffer[0];
+            if (calculated_integrals == nullptr) {
+                continue;
+            }
+
+            auto nbf_sh1 = auxiliary_basisset[sh1].size();
+            auto nbf_sh2 = auxiliary_basisset[sh2].size();
+            for (size_t f1 = 0; f1 < nbf_sh1; f1++) {
+                for (size_t f2 = 0; f2 < nbf_sh2; f2++) {
+                    auto P = shell2bf_aux[sh1] + f1;
+                    auto Q = shell2bf_aux[sh2] + f2;
+
+                    metric(P, Q) = calculated_integrals[f2 + nbf_sh2 * f1];  // integrals are packed in row-major form
+                    metric(Q, P) = metric(P, Q);
+                }
+            }
+        }
+    }
+
+
+    // 2) Calculate the three-center integrals (P|pq), in which every column P holds a column-major K x K matrix
+    // The auxiliary shells are handed out dynamically to the threads, and every one of them fills its own columns
+    Eigen::MatrixXd three_center_integrals = Eigen::MatrixXd::Zero(nbf * nbf, naux);
+
+    libint2::Engine three_center_engine (libint2::Operator::coulomb, max_nprim, max_l, 0, this->accuracy);
+    three_center_engine.set(libint2::BraKet::xs_xx);
+    std::atomic<size_t> next_auxiliary_shell (0);
+
+    this->parallelize([&] (size_t) {
+
+        libint2::Engine thread_engine (three_center_engine);  // every thread needs its own engine, so we clone the original one
+        const auto& buffer = thread_engine.results();
+
+        for (size_t sh_aux = next_auxiliary_shell++; sh_aux < nsh_aux; sh_aux = next_auxiliary_shell++) {
+            for (size_t sh1 = 0; sh1 < nsh; sh1++) {
+                for (size_t sh2 = 0; sh2 <= sh1; sh2++) {
+                    thread_engine.compute(auxiliary_basisset[sh_aux], unit_shell, libint_basisset[sh1], libint_basisset[sh2]);
+
+                    auto calculated_integrals = buffer[0];
+                    if (calculated_integrals == nullptr) {
+                        continue;
+                    }
+
+                    auto nbf_aux = auxiliary_basisset[sh_aux].size();
+                    auto nbf_sh1 = libint_basisset[sh1].size();
+                    auto nbf_sh2 = libint_basisset[sh2].size();
+                    for (size_t fP = 0; fP < nbf_aux; fP++) {
+                        for (size_t f1 = 0; f1 < nbf_sh1; f1++) {
+                            for (size_t f2 = 0; f2 < nbf_sh2; f2++) {
+                                auto P = shell2bf_aux[sh_aux] + fP;
+                                auto p = shell2bf[sh1] + f1;
+                                auto q = shell2bf[sh2] + f2;
+
+                                double integral = calculated_integrals[f2 + nbf_sh2 * (f1 + nbf_sh1 * fP)];  // integrals are packed in row-major form
+                                three_center_integrals(p + nbf * q, P) = integral;
+                                three_center_integrals(q + nbf * p, P) = integral;
                             }
                         }
-                    } // data access loops
+                    }
+                }
+            }
+        }  // auxiliary shell loop
+    });
+
+
+    // 3) Form the fitted factors B = (P|pq) (P|Q)^(-1/2), discarding the (numerically) linearly dependent auxiliary functions
+    Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> metric_eigensolver (metric);
+    const auto& eigenvalues = metric_eigensolver.eigenvalues();
+    const auto& eigenvectors = metric_eigensolver.eigenvectors();
+
+    const double linear_dependency_threshold = 1.0e-10 * eigenvalues.maxCoeff();
+    Eigen::VectorXd inverse_sqrt_eigenvalues = Eigen::VectorXd::Zero(naux);
+    for (size_t i = 0; i < naux; i++) {
+        if (eigenvalues(i) > linear_dependency_threshold) {
+            inverse_sqrt_eigenvalues(i) = 1.0 / std::sqrt(eigenvalues(i));
+        }
+    }
+    Eigen::MatrixXd metric_inverse_sqrt = eigenvectors * inverse_sqrt_eigenvalues.asDiagonal() * eigenvectors.transpose();
+
+    Eigen::MatrixXd factors = three_center_integrals * metric_inverse_sqrt;
+
+    return GQCG::TwoElectronOperator(std::move(factors));
+}
+
+
+
+/**
+ *  @return the first derivatives of the matrix representation of @param operator_type (overlap, kinetic or nuclear)
+ *  in the given @param ao_basis with respect to the nuclear coordinates: the derivative with respect to coordinate
+ *  x (0, 1 or 2) of atom A is found at index 3 * A + x
+ */
+std::vector<GQCG::OneElectronOperator> LibintCommunicator::calculateOneElectronIntegralDerivatives(libint2::Operator operator_type, const GQCG::AOBasis& ao_basis) const {
 
+    if ((operator_type != libint2::Operator::overlap) && (operator_type != libint2::Operator::kinetic) && (operator_type != libint2::Operator::nuclear)) {
+        throw std::invalid_argument("Only the derivatives of the overlap, kinetic and nuclear attraction integrals can be calculated.");
+    }
+
+
+    const auto& libint_basisset = ao_basis.basis_functions;
+    const auto nbf = static_cast<size_t>(libint_basisset.nbf());  // nbf: number of basis functions in the basisset
+    const auto nsh = static_cast<size_t>(libint_basisset.size());  // nsh: number of shells in the basisset
+
+    const auto libint_atoms = this->interface(ao_basis.atoms);
+    const auto number_of_coordinates = 3 * libint_atoms.size();
+    auto point_charges = make_point_charges(libint_atoms);
+
+    const auto shell2bf = libint_basisset.shell2bf();  // maps shell index to bf index
+    const auto shell2atom = libint_basisset.shell2atom(libint_atoms);  // maps shell index to atom index
+
+    std::vector<Eigen::MatrixXd> matrices (number_of_coordinates, Eigen::MatrixXd::Zero(nbf, nbf));
+
+
+    // For the shell pair (ab), libint calculates the derivatives with respect to the centers of a (shell sets 0-2) and
+    // b (shell sets 3-5) and, for the nuclear attraction integrals, with respect to every point charge (3 shell sets each)
+    // The derivative with respect to an atom is the sum of the derivatives with respect to all the centers on that atom
+    // Every unique shell pair writes to its own elements, so the threads never write to the same element
+    // As for the integrals themselves, the shell pairs are visited in an order that is sorted by the (l, nprim) class of the shells
+    const auto number_of_shell_pairs = nsh * (nsh + 1) / 2;
+    const auto shell_order = LibintCommunicator::sortedShellOrder(libint_basisset);
+    std::atomic<size_t> next_shell_pair (0);
+
+    this->parallelize([&] (size_t) {
+
+        auto thread_engine = this->checkoutEngine(operator_type, libint_basisset.max_nprim(), static_cast<int>(libint_basisset.max_l()), 1);
+        if (operator_type == libint2::Operator::nuclear) {
+            thread_engine->set_params(point_charges);
+        }
+        const auto& buffer = thread_engine->results();
+
+        for (size_t i12 = next_shell_pair++; i12 < number_of_shell_pairs; i12 = next_shell_pair++) {
+
+            // Find i1 >= i2 that correspond to the compound index i12 = i1 * (i1 + 1) / 2 + i2, in the sorted shell order
+            size_t i1, i2;
+            std::tie(i1, i2) = LibintCommunicator::unpairIndex(i12);
+
+            auto sh1 = shell_order[i1];  // sh1: shell 1
+            auto sh2 = shell_order[i2];  // sh2: shell 2
+
+            auto bf1 = shell2bf[sh1];  // (index of) first bf in sh1
+            auto bf2 = shell2bf[sh2];  // (index of) first bf in sh2
+
+            auto nbf_sh1 = libint_basisset[sh1].size();  // number of basis functions in first shell
+            auto nbf_sh2 = libint_basisset[sh2].size();  // number of basis functions in second shell
+
+            thread_engine->compute(libint_basisset[sh1], libint_basisset[sh2]);
+
+            for (size_t shell_set = 0; shell_set < buffer.size(); shell_set++) {
+                auto calculated_integrals = buffer[shell_set];
+                if (calculated_integrals == nullptr) {  // the derivative integrals are negligible
+                    continue;
+                }
+
+                // Find the atom that the centers of this shell set belong to
+                size_t atom;
+                if (shell_set < 3) {
+                    atom = static_cast<size_t>(shell2atom[sh1]);
+                } else if (shell_set < 6) {
+                    atom = static_cast<size_t>(shell2atom[sh2]);
+                } else {
+                    atom = (shell_set - 6) / 3;  // there is a point charge for every atom
+                }
+                auto& matrix = matrices[3 * atom + shell_set % 3];
+
+                for (size_t f1 = 0; f1 != nbf_sh1; ++f1) {  // f1: index of basis function within shell 1
+                    for (size_t f2 = 0; f2 != nbf_sh2; ++f2) {  // f2: index of basis function within shell 2
+                        double computed_integral = calculated_integrals[f2 + f1 * nbf_sh2];  // integrals are packed in row-major form
+
+                        matrix(bf1 + f1, bf2 + f2) += computed_integral;
+                        if (sh1 != sh2) {  // the elements of a diagonal shell pair are already all calculated
+                            matrix(bf2 + f2, bf1 + f1) += computed_integral;
+                        }
+                    }
+                }  // data access loops
+            }
+        }  // shell pair loop
+    });
+
+
+    std::vector<GQCG::OneElectronOperator> operators;
+    for (auto& matrix : matrices) {
+        operators.emplace_back(std::move(matrix));
+    }
+
+    return operators;
+}
+
+
+/**
+ *  @return the first derivatives of the matrix representation of @param operator_type (coulomb) in the given
+ *  @param ao_basis with respect to the nuclear coordinates, in the given @param storage (dense or packed): the
+ *  derivative with respect to coordinate x (0, 1 or 2) of atom A is found at index 3 * A + x
+ */
+std::vector<GQCG::TwoElectronOperator> LibintCommunicator::calculateTwoElectronIntegralDerivatives(libint2::Operator operator_type, const GQCG::AOBasis& ao_basis, GQCG::TwoElectronStorage storage) const {
+
+    if (operator_type != libint2::Operator::coulomb) {
+        throw std::invalid_argument("Only the derivatives of the Coulomb integrals can be calculated.");
+    }
+
+    if ((storage != GQCG::TwoElectronStorage::dense) && (storage != GQCG::TwoElectronStorage::packed)) {
+        throw std::invalid_argument("The derivatives of the two-electron integrals can only be given in the dense or packed storage.");
+    }
+
+
+    const auto& libint_basisset = ao_basis.basis_functions;
+    const auto nbf = static_cast<size_t>(libint_basisset.nbf());  // nbf: number of basis functions in the basisset
+    const auto nsh = static_cast<size_t>(libint_basisset.size());  // nsh: number of shells in the basisset
+
+    const auto libint_atoms = this->interface(ao_basis.atoms);
+    const auto number_of_coordinates = 3 * libint_atoms.size();
+
+    const auto shell2bf = libint_basisset.shell2bf();  // maps shell index to bf index
+    const auto shell2atom = libint_basisset.shell2atom(libint_atoms);  // maps shell index to atom index
+
+
+    // Initialize the derivative tensors (or their packed symmetry-unique elements) and set to zero
+    std::vector<Eigen::Tensor<double, 4>> tensors;
+    std::vector<Eigen::VectorXd> packed_elements;
+    if (storage == GQCG::TwoElectronStorage::dense) {
+        Eigen::Tensor<double, 4> tensor (nbf, nbf, nbf, nbf);
+        tensor.setZero();
+        tensors.assign(number_of_coordinates, tensor);
+    } else {
+        packed_elements.assign(number_of_coordinates, Eigen::VectorXd::Zero(GQCG::TwoElectronOperator::numberOfPackedElements(nbf)));
+    }
+
+
+    // For the shell quartet (ab|cd), libint calculates the derivatives with respect to the centers of a, b, c and d (3
+    // shell sets each). The derivative with respect to an atom is the sum of the derivatives with respect to all the
+    // centers on that atom
+    // As in visitTwoElectronIntegrals, only the canonical shell quartets (in the order that is sorted by the (l, nprim)
+    // class of the shells) are calculated and every one of them writes to its own, distinct elements. Inside a shell
+    // quartet, symmetry-equivalent elements may appear more than once, so the summed derivatives are assigned instead
+    // of accumulated
+    const auto number_of_shell_pairs = nsh * (nsh + 1) / 2;
+    const auto shell_order = LibintCommunicator::sortedShellOrder(libint_basisset);
+    std::atomic<size_t> next_shell_pair (0);
+
+    this->parallelize([&] (size_t) {
+
+        auto thread_engine = this->checkoutEngine(libint2::Operator::coulomb, libint_basisset.max_nprim(), static_cast<int>(libint_basisset.max_l()), 1);
+        const auto& buffer = thread_engine->results();
+
+        for (size_t counter = next_shell_pair++; counter < number_of_shell_pairs; counter = next_shell_pair++) {
+            auto i12 = number_of_shell_pairs - 1 - counter;  // the most expensive bra shell pairs are handed out first
+
+            // Find i1 >= i2 that correspond to the compound index i12 = i1 * (i1 + 1) / 2 + i2, in the sorted shell order
+            size_t i1, i2;
+            std::tie(i1, i2) = LibintCommunicator::unpairIndex(i12);
+
+            auto sh1 = shell_order[i1];  // sh1: shell 1
+            auto sh2 = shell_order[i2];  // sh2: shell 2
+
+            for (size_t i3 = 0; i3 <= i1; ++i3) {
+                auto sh3 = shell_order[i3];  // sh3: shell 3
+
+                for (size_t i4 = 0; i4 <= i3; ++i4) {
+                    auto sh4 = shell_order[i4];  // sh4: shell 4
+
+                    if (i3 * (i3 + 1) / 2 + i4 > i12) {  // this shell quartet is the permutation of a canonical one
+                        break;
+                    }
+
+                    thread_engine->compute(libint_basisset[sh1], libint_basisset[sh2], libint_basisset[sh3], libint_basisset[sh4]);
+                    if (buffer[0] == nullptr) {  // the derivative integrals are negligible
+                        continue;
+                    }
+
+                    const std::array<size_t, 4> shells {sh1, sh2, sh3, sh4};
+                    const std::array<size_t, 4> nbf_sh {libint_basisset[sh1].size(), libint_basisset[sh2].size(), libint_basisset[sh3].size(), libint_basisset[sh4].size()};
+
+                    // Find the (distinct) atoms of the four centers
+                    std::vector<size_t> atoms;
+                    for (const auto& shell : shells) {
+                        auto atom = static_cast<size_t>(shell2atom[shell]);
+                        if (std::find(atoms.begin(), atoms.end(), atom) == atoms.end()) {
+                            atoms.push_back(atom);
+                        }
+                    }
+
+                    for (const auto& atom : atoms) {
+                        for (size_t x = 0; x < 3; x++) {
+                            auto coordinate = 3 * atom + x;
+
+                            for (size_t f1 = 0; f1 != nbf_sh[0]; ++f1) {
+                                for (size_t f2 = 0; f2 != nbf_sh[1]; ++f2) {
+                                    for (size_t f3 = 0; f3 != nbf_sh[2]; ++f3) {
+                                        for (size_t f4 = 0; f4 != nbf_sh[3]; ++f4) {
+                                            auto f1234 = f4 + nbf_sh[3] * (f3 + nbf_sh[2] * (f2 + nbf_sh[1] * f1));  // integrals are packed in row-major form
+
+                                            double derivative = 0.0;
+                                            for (size_t center = 0; center < 4; center++) {
+                                                if (static_cast<size_t>(shell2atom[shells[center]]) == atom) {
+                                                    derivative += buffer[3 * center + x][f1234];
+                                                }
+                                            }
+
+                                            // Two-electron integrals are given in CHEMIST'S notation: (11|22)
+                                            auto p = static_cast<long>(f1 + shell2bf[sh1]);
+                                            auto q = static_cast<long>(f2 + shell2bf[sh2]);
+                                            auto r = static_cast<long>(f3 + shell2bf[sh3]);
+                                            auto s = static_cast<long>(f4 + shell2bf[sh4]);
+
+                                            if (storage == GQCG::TwoElectronStorage::packed) {
+                                                packed_elements[coordinate](GQCG::TwoElectronOperator::packedIndex(p, q, r, s)) = derivative;
+                                                continue;
+                                            }
+
+                                            // Scatter the derivative to all its symmetry-equivalent positions
+                                            auto& tensor = tensors[coordinate];
+                                            tensor(p, q, r, s) = derivative;
+                                            tensor(q, p, r, s) = derivative;
+                                            tensor(p, q, s, r) = derivative;
+                                            tensor(q, p, s, r) = derivative;
+                                            tensor(r, s, p, q) = derivative;
+                                            tensor(s, r, p, q) = derivative;
+                                            tensor(r, s, q, p) = derivative;
+                                            tensor(s, r, q, p) = derivative;
+                                        }
+                                    }
+                                }
+                            }  // data access loops
+                        }
+                    }
                 }
             }
+        }  // shell loops
+    });
+
+
+    std::vector<GQCG::TwoElectronOperator> operators;
+    for (size_t coordinate = 0; coordinate < number_of_coordinates; coordinate++) {
+        if (storage == GQCG::TwoElectronStorage::dense) {
+            operators.emplace_back(std::move(tensors[coordinate]));
+        } else {
+            operators.emplace_back(std::move(packed_elements[coordinate]), nbf);
         }
-    } // shell loops
+    }
 
-    return GQCG::TwoElectronOperator(tensor);
-};
+    return operators;
+}
 
 
 }  // namespace GQCG
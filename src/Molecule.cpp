@@ -1,7 +1,9 @@
 #include "Molecule.hpp"
 
 #include <algorithm>
+#include <cmath>
 #include <fstream>
+#include <tuple>
 #include <sstream>
 #include <stdexcept>
 
@@ -82,6 +84,16 @@ std::vector<GQCG::Atom> Molecule::parseXYZFile(const std::string& xyz_filename)
 }
 
 
+/**
+ *  @return the given @param atoms, sorted with GQCG::Atom::operator<
+ */
+std::vector<GQCG::Atom> Molecule::sortAtoms(std::vector<GQCG::Atom> atoms) {
+
+    std::sort(atoms.begin(), atoms.end());
+    return atoms;
+}
+
+
 
 /*
  *  CONSTRUCTORS
@@ -98,7 +110,8 @@ std::vector<GQCG::Atom> Molecule::parseXYZFile(const std::string& xyz_filename)
  */
 Molecule::Molecule(const std::vector<GQCG::Atom>& atoms, int molecular_charge) :
     atoms (atoms),
-    N (this->calculateTotalNucleicCharge() - molecular_charge)
+    N (this->calculateTotalNucleicCharge() - molecular_charge),
+    sorted_atoms (Molecule::sortAtoms(atoms))
 {
     // Check if the total positive charge is valid, e.g. H^(2+) does not exist
     if (molecular_charge > 0) {
@@ -107,16 +120,8 @@ Molecule::Molecule(const std::vector<GQCG::Atom>& atoms, int molecular_charge) :
         }
     }
 
-    // Check if there are no duplicate atoms
-    // The atoms are const, so we will make a copy to check if there are duplicates
-    auto atoms_copy = this->atoms;
-
-    // Sort and unique
-    std::sort(atoms_copy.begin(), atoms_copy.end());
-    auto last_it = std::unique(atoms_copy.begin(), atoms_copy.end());
-
-    // If the iterator returned from unique is the same as the end iterator, there are no duplicate items
-    if (last_it != atoms_copy.end()) {
+    // Check if there are no duplicate atoms: since the atoms are sorted, duplicates would be adjacent
+    if (std::adjacent_find(this->sorted_atoms.begin(), this->sorted_atoms.end()) != this->sorted_atoms.end()) {
         throw std::invalid_argument("There can't be two equal atoms on the same position.");
     }
 }
@@ -194,21 +199,29 @@ std::ostream& operator<<(std::ostream& os, const GQCG::Molecule& molecule) {
  */
 bool Molecule::isEqualTo(const GQCG::Molecule& other, double tolerance) const {
 
-    if (this->N != other.get_N()) {
+    if ((this->N != other.get_N()) || (this->numberOfAtoms() != other.numberOfAtoms())) {
         return false;
     }
 
     // We don't want the order of the atoms to matter in a GQCG::Molecule comparison
-    // We have implemented a custom GQCG::Atom::operator< so we can sort std::vectors of GQCG::Atoms
-    // Make a copy of the atoms because std::sort modifies
-    auto this_atoms = this->atoms;
-    auto other_atoms = other.atoms;
+    // Since both atom vectors have already been sorted upon construction, we can compare them atom by atom
+    auto equal_atom = [tolerance] (const GQCG::Atom& lhs, const GQCG::Atom& rhs) { return lhs.isEqualTo(rhs, tolerance); };
+
+    if (std::equal(this->sorted_atoms.begin(), this->sorted_atoms.end(), other.sorted_atoms.begin(), equal_atom)) {
+        return true;
+    }
 
+    if (tolerance <= GQCG::Atom::tolerance_for_comparison) {  // the sorted order can't depend on a smaller tolerance
+        return false;
+    }
 
-    // Make lambda expressions for the comparators, since we want to hand over the tolerance argument
-    auto smaller_than_atom = [this, tolerance](const GQCG::Atom& lhs, const GQCG::Atom& rhs) { return lhs.isSmallerThan(rhs, tolerance); };
-    auto equal_atom = [this, tolerance](const GQCG::Atom& lhs, const GQCG::Atom& rhs) { return lhs.isEqualTo(rhs, tolerance); };
 
+    // For a larger tolerance, coordinates that are considered equal may have been sorted differently, so we have to sort again
+    // Make a copy of the atoms because std::sort modifies
+    auto this_atoms = this->sorted_atoms;
+    auto other_atoms = other.sorted_atoms;
+
+    auto smaller_than_atom = [tolerance] (const GQCG::Atom& lhs, const GQCG::Atom& rhs) { return lhs.isSmallerThan(rhs, tolerance); };
 
     std::sort(this_atoms.begin(), this_atoms.end(), smaller_than_atom);
     std::sort(other_atoms.begin(), other_atoms.end(), smaller_than_atom);
@@ -217,6 +230,63 @@ bool Molecule::isEqualTo(const GQCG::Molecule& other, double tolerance) const {
 }
 
 
+/**
+ *  @return a fingerprint of the geometry of this molecule, in which the internuclear distances are rounded to the
+ *  given @param tolerance
+ *
+ *  The fingerprint is built from the number of electrons, the sorted atomic numbers and the sorted internuclear
+ *  distances (labeled by the atomic numbers of both atoms), so it doesn't change if the molecule is translated,
+ *  rotated, reflected or if its atoms are reordered
+ */
+uint64_t Molecule::fingerprint(double tolerance) const {
+
+    if (tolerance <= 0.0) {
+        throw std::invalid_argument("The tolerance for the fingerprint should be positive.");
+    }
+
+    uint64_t hash = 14695981039346656037ULL;  // the FNV-1a offset basis
+    auto add_value = [&hash] (uint64_t value) {
+        for (size_t i = 0; i < sizeof(value); i++) {  // byte by byte, so that the fingerprint doesn't depend on the endianness
+            hash ^= (value >> (8 * i)) & 0xff;
+            hash *= 1099511628211ULL;  // the FNV-1a prime
+        }
+    };
+
+
+    auto natoms = this->numberOfAtoms();
+    add_value(static_cast<uint64_t>(this->N));
+    add_value(static_cast<uint64_t>(natoms));
+
+    for (const auto& atom : this->sorted_atoms) {  // sorted by atomic number first
+        add_value(static_cast<uint64_t>(atom.atomic_number));
+    }
+
+
+    // Unlike the coordinates, the internuclear distances don't depend on the position or orientation of the molecule
+    // Every distance is labeled by the (ordered) atomic numbers of both atoms, and is rounded to the tolerance
+    std::vector<std::tuple<size_t, size_t, int64_t>> labeled_distances;
+    labeled_distances.reserve(natoms * (natoms - 1) / 2);
+    for (size_t i = 0; i < natoms; i++) {
+        for (size_t j = i + 1; j < natoms; j++) {
+            const auto& atom1 = this->sorted_atoms[i];
+            const auto& atom2 = this->sorted_atoms[j];
+
+            auto rounded_distance = static_cast<int64_t>(std::llround(atom1.calculateDistance(atom2) / tolerance));
+            labeled_distances.emplace_back(std::min(atom1.atomic_number, atom2.atomic_number), std::max(atom1.atomic_number, atom2.atomic_number), rounded_distance);
+        }
+    }
+    std::sort(labeled_distances.begin(), labeled_distances.end());
+
+    for (const auto& labeled_distance : labeled_distances) {
+        add_value(static_cast<uint64_t>(std::get<0>(labeled_distance)));
+        add_value(static_cast<uint64_t>(std::get<1>(labeled_distance)));
+        add_value(static_cast<uint64_t>(std::get<2>(labeled_distance)));
+    }
+
+    return hash;
+}
+
+
 /**
  *  @return the sum of all the charges of the nuclei
  */
@@ -1,29 +1,107 @@
 #include "Operator/OneElectronOperator.hpp"
 
 #include <stdexcept>
+#include <utility>
 
 
 namespace GQCG {
 
 
 /*
- *  CONSTRUCTOR
+ *  CONSTRUCTORS
  */
 
 /**
- *  Constructor based on a given @param matrix
+ *  Constructor based on a given @param matrix, which is moved from if it is given as an rvalue
  */
-OneElectronOperator::OneElectronOperator(const Eigen::MatrixXd& matrix) :
+OneElectronOperator::OneElectronOperator(Eigen::MatrixXd matrix) :
     BaseOperator(matrix.cols()),
-    matrix (matrix)
+    storage (OneElectronStorage::dense),
+    matrix (std::move(matrix))
 {
     // Check if the one-electron integrals are represented as a square matrix
-    if (matrix.cols() != matrix.rows()) {
+    if (this->matrix.cols() != this->matrix.rows()) {
         throw std::invalid_argument("One-electron integrals have to be represented as a square matrix.");
     }
 }
 
 
+/**
+ *  Constructor based on a given @param sparse_matrix, which leads to the sparse storage
+ */
+OneElectronOperator::OneElectronOperator(Eigen::SparseMatrix<double> sparse_matrix) :
+    BaseOperator(sparse_matrix.cols()),
+    storage (OneElectronStorage::sparse),
+    sparse_matrix (std::move(sparse_matrix))
+{
+    // Check if the one-electron integrals are represented as a square matrix
+    if (this->sparse_matrix.cols() != this->sparse_matrix.rows()) {
+        throw std::invalid_argument("One-electron integrals have to be represented as a square matrix.");
+    }
+}
+
+
+
+/*
+ *  GETTERS
+ */
+
+/**
+ *  @return the full matrix representation of the one-electron operator, which is expanded for the sparse storage
+ */
+Eigen::MatrixXd OneElectronOperator::get_matrix_representation() const {
+
+    if (this->storage == OneElectronStorage::sparse) {
+        return Eigen::MatrixXd(this->sparse_matrix);
+    }
+
+    return this->matrix;
+}
+
+
+/**
+ *  @return the dense matrix representation without a copy
+ *
+ *  Throws if the one-electron operator isn't in the dense storage
+ */
+const Eigen::MatrixXd& OneElectronOperator::get_matrix() const {
+
+    if (this->storage != OneElectronStorage::dense) {
+        throw std::runtime_error("The one-electron operator isn't in the dense storage.");
+    }
+
+    return this->matrix;
+}
+
+
+/**
+ *  @return the sparse matrix representation without a copy
+ *
+ *  Throws if the one-electron operator isn't in the sparse storage
+ */
+const Eigen::SparseMatrix<double>& OneElectronOperator::get_sparse_matrix() const {
+
+    if (this->storage != OneElectronStorage::sparse) {
+        throw std::runtime_error("The one-electron operator isn't in the sparse storage.");
+    }
+
+    return this->sparse_matrix;
+}
+
+
+/**
+ *  @return the element at @param index1 and @param index2 of the matrix representation
+ */
+double OneElectronOperator::get(size_t index1, size_t index2) const {
+
+    if (this->storage == OneElectronStorage::sparse) {
+        return this->sparse_matrix.coeff(index1, index2);
+    }
+
+    return this->matrix(index1, index2);
+}
+
+
 
 /*
  *  OPERATORS
@@ -34,7 +112,19 @@ OneElectronOperator::OneElectronOperator(const Eigen::MatrixXd& matrix) :
  *  of the two matrix representations of the given OneElectronOperators
  */
 GQCG::OneElectronOperator OneElectronOperator::operator+(const GQCG::OneElectronOperator& other) {
-    
+
+    if ((this->storage == OneElectronStorage::sparse) && (other.storage == OneElectronStorage::sparse)) {
+        return OneElectronOperator(Eigen::SparseMatrix<double>(this->sparse_matrix + other.sparse_matrix));
+    }
+
+    if (this->storage == OneElectronStorage::sparse) {
+        return OneElectronOperator(Eigen::MatrixXd(other.matrix + this->sparse_matrix));
+    }
+
+    if (other.storage == OneElectronStorage::sparse) {
+        return OneElectronOperator(Eigen::MatrixXd(this->matrix + other.sparse_matrix));
+    }
+
     return OneElectronOperator(this->matrix + other.matrix);
 }
 
@@ -44,6 +134,38 @@ GQCG::OneElectronOperator OneElectronOperator::operator+(const GQCG::OneElectron
  *  PUBLIC METHODS
  */
 
+/**
+ *  Convert the matrix representation to the sparse storage, dropping the elements whose absolute value is not larger
+ *  than the given @param threshold
+ */
+void OneElectronOperator::sparsify(double threshold) {
+
+    if (this->storage == OneElectronStorage::sparse) {
+        this->sparse_matrix.prune(1.0, threshold);  // prune() and sparseView() keep the elements with |value| > reference * epsilon
+        return;
+    }
+
+    this->sparse_matrix = this->matrix.sparseView(1.0, threshold);
+    this->matrix = Eigen::MatrixXd ();  // release the memory of the dense matrix
+    this->storage = OneElectronStorage::sparse;
+}
+
+
+/**
+ *  Convert the matrix representation to the dense storage
+ */
+void OneElectronOperator::densify() {
+
+    if (this->storage == OneElectronStorage::dense) {
+        return;
+    }
+
+    this->matrix = this->get_matrix_representation();
+    this->sparse_matrix = Eigen::SparseMatrix<double> ();  // release the memory of the sparse matrix
+    this->storage = OneElectronStorage::dense;
+}
+
+
 /**
  *  Transform the matrix representation of a one-electron operator using the transformation matrix @param T
  *
@@ -52,7 +174,23 @@ GQCG::OneElectronOperator OneElectronOperator::operator+(const GQCG::OneElectron
  *  in which the basis functions are collected as elements of a row vector b
  */
 void OneElectronOperator::transform(const Eigen::MatrixXd& T) {
-    this->matrix = T.adjoint() * this->matrix * T;
+
+    if (T.rows() != this->dim) {
+        throw std::invalid_argument("The number of rows of the transformation matrix should be the dimension of the operator.");
+    }
+
+
+    if (this->storage == OneElectronStorage::sparse) {
+        Eigen::MatrixXd half_transformed = this->sparse_matrix * T;  // a sparse-dense product
+
+        this->matrix = T.adjoint() * half_transformed;
+        this->sparse_matrix = Eigen::SparseMatrix<double> ();  // release the memory of the sparse matrix
+        this->storage = OneElectronStorage::dense;
+    } else {
+        this->matrix = T.adjoint() * this->matrix * T;
+    }
+
+    this->dim = static_cast<size_t>(T.cols());  // a rectangular transformation matrix changes the dimension
 }
 
 
@@ -96,6 +234,8 @@ void OneElectronOperator::rotate(const GQCG::JacobiRotationParameters& jacobi_ro
     // Use Eigen's Jacobi module to apply the Jacobi rotations directly (cfr. T.adjoint() * h * T)
     Eigen::JacobiRotation<double> jacobi (c, s);
 
+    this->densify();
+
     this->matrix.applyOnTheLeft(p, q, jacobi.adjoint());
     this->matrix.applyOnTheRight(p, q, jacobi);
 }
@@ -1,74 +1,815 @@
 #include "Operator/TwoElectronOperator.hpp"
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <limits>
+#include <stdexcept>
 
-#include "miscellaneous.hpp"
 
 
 namespace GQCG {
 
 
+constexpr double TwoElectronOperator::default_error_bound;
+
+
+
+/*
+ *  CONSTRUCTORS
+ */
+
 /**
  *  Constructor based on a given @param tensor
  */
-TwoElectronOperator::TwoElectronOperator(const Eigen::Tensor<double, 4>& tensor) :
+TwoElectronOperator::TwoElectronOperator(Eigen::Tensor<double, 4> tensor) :
     BaseOperator(tensor.dimensions()[0]),
-    tensor (tensor)
+    storage (TwoElectronStorage::dense),
+    tensor (std::move(tensor)),
+    error_bound (0.0)
 {
     // Check if the given tensor is 'square'
-    auto dims = tensor.dimensions();
+    auto dims = this->tensor.dimensions();
     if ((dims[0] != dims[1]) || (dims[1] != dims[2]) || (dims[2] != dims[3]) ) {
         throw std::invalid_argument("The given tensor should have equal dimensions in every rank.");
     }
 }
 
 
+/**
+ *  Constructor based on the symmetry-unique elements @param packed_elements (addressed by packedIndex()) of a
+ *  two-electron operator in an orbital basis of dimension @param K
+ */
+TwoElectronOperator::TwoElectronOperator(Eigen::VectorXd packed_elements, size_t K) :
+    BaseOperator(K),
+    storage (TwoElectronStorage::packed),
+    packed_elements (std::move(packed_elements)),
+    error_bound (0.0)
+{
+    if (this->packed_elements.size() != TwoElectronOperator::numberOfPackedElements(K)) {
+        throw std::invalid_argument("The number of given packed elements is incompatible with the given dimension.");
+    }
+}
+
+
+
+/**
+ *  Constructor based on the given @param factors: every column is a factor L^L as a column-major K x K matrix, such
+ *  that (pq|rs) = sum_L L^L_pq L^L_rs
+ */
+TwoElectronOperator::TwoElectronOperator(Eigen::MatrixXd factors) :
+    BaseOperator(static_cast<size_t>(std::lround(std::sqrt(factors.rows())))),
+    storage (TwoElectronStorage::factorized),
+    factors (std::move(factors)),
+    error_bound (0.0)
+{
+    if (this->dim * this->dim != this->factors.rows()) {
+        throw std::invalid_argument("The number of rows of the given factors should be the square of the dimension.");
+    }
+}
+
+
+
+/*
+ *  GETTERS
+ */
+
+/**
+ *  @return the full matrix representation of the two-electron operator, which is unpacked for the packed storage
+ */
+Eigen::Tensor<double, 4> TwoElectronOperator::get_matrix_representation() const {
+
+    if (this->storage == TwoElectronStorage::dense) {
+        return this->tensor;
+    }
+
+
+    auto K = static_cast<long>(this->dim);
+
+    if (this->storage == TwoElectronStorage::factorized) {
+        // In column-major storage, the tensor (pq|rs) has the same memory layout as the K^2 x K^2 matrix sum_L L^L_pq L^L_rs
+        Eigen::Tensor<double, 4> tensor (K, K, K, K);
+        Eigen::Map<Eigen::MatrixXd> tensor_map (tensor.data(), K*K, K*K);
+        tensor_map.noalias() = this->factors * this->factors.transpose();
+        return tensor;
+    }
+
+    // The packed and mixed storages are unpacked from their (double precision) symmetry-unique elements
+    Eigen::VectorXd unmixed_elements;
+    if (this->storage == TwoElectronStorage::mixed) {
+        unmixed_elements = this->unmixPackedElements();
+    }
+    const auto& elements = (this->storage == TwoElectronStorage::mixed) ? unmixed_elements : this->packed_elements;
+
+    Eigen::Tensor<double, 4> tensor (K, K, K, K);
+    for (long p = 0; p < K; p++) {
+        for (long q = 0; q < K; q++) {
+            for (long r = 0; r < K; r++) {
+                for (long s = 0; s < K; s++) {
+                    tensor(p, q, r, s) = elements(TwoElectronOperator::packedIndex(p, q, r, s));
+                }
+            }
+        }
+    }
+
+    return tensor;
+}
+
+
+/**
+ *  @return the dense matrix representation without a copy
+ *
+ *  Throws if the two-electron operator isn't in the dense storage
+ */
+const Eigen::Tensor<double, 4>& TwoElectronOperator::get_tensor() const {
+
+    if (this->storage != TwoElectronStorage::dense) {
+        throw std::runtime_error("The two-electron operator isn't in the dense storage.");
+    }
+
+    return this->tensor;
+}
+
+
+/**
+ *  @return the symmetry-unique elements without a copy
+ *
+ *  Throws if the two-electron operator isn't in the packed storage
+ */
+const Eigen::VectorXd& TwoElectronOperator::get_packed_elements() const {
+
+    if (this->storage != TwoElectronStorage::packed) {
+        throw std::runtime_error("The two-electron operator isn't in the packed storage.");
+    }
+
+    return this->packed_elements;
+}
+
+
+/**
+ *  @return the factors (as columns) without a copy
+ *
+ *  Throws if the two-electron operator isn't in the factorized storage
+ */
+const Eigen::MatrixXd& TwoElectronOperator::get_factors() const {
+
+    if (this->storage != TwoElectronStorage::factorized) {
+        throw std::runtime_error("The two-electron operator isn't in the factorized storage.");
+    }
+
+    return this->factors;
+}
+
+
+/**
+ *  @return the element (index1 index2|index3 index4) of the matrix representation
+ */
+double TwoElectronOperator::get(size_t index1, size_t index2, size_t index3, size_t index4) const {
+
+    if ((this->storage == TwoElectronStorage::packed) || (this->storage == TwoElectronStorage::mixed)) {
+        return this->packedElement(TwoElectronOperator::packedIndex(index1, index2, index3, index4));
+    }
+
+    if (this->storage == TwoElectronStorage::factorized) {
+        auto K = this->dim;
+        return this->factors.row(index1 + K * index2).dot(this->factors.row(index3 + K * index4));
+    }
+
+    return this->tensor(index1, index2, index3, index4);
+}
+
+
+
+/*
+ *  STATIC PUBLIC METHODS
+ */
+
+/**
+ *  @return the number of symmetry-unique elements of a two-electron operator in an orbital basis of dimension @param K
+ */
+size_t TwoElectronOperator::numberOfPackedElements(size_t K) {
+
+    auto number_of_pairs = K * (K + 1) / 2;
+    return number_of_pairs * (number_of_pairs + 1) / 2;
+}
+
+
+/**
+ *  @return if the mixed storage of @param number_of_elements symmetry-unique elements, of which
+ *  @param number_of_double_precision_elements are kept in double precision, is smaller than their packed storage
+ *
+ *  Every element takes a float, and every double precision element also takes its (packed index, value) in the
+ *  correction list, while the packed storage takes a double for every element
+ */
+bool TwoElectronOperator::isMixedStorageSmaller(size_t number_of_elements, size_t number_of_double_precision_elements) {
+
+    return number_of_double_precision_elements * sizeof(std::pair<size_t, double>) < number_of_elements * (sizeof(double) - sizeof(float));
+}
+
+
 
 /*
  *  PUBLIC METHODS
  */
 
+/**
+ *  Convert the matrix representation to the packed storage, keeping only the symmetry-unique elements
+ *
+ *  Note that the matrix representation is assumed to have the 8-fold permutational symmetry
+ */
+void TwoElectronOperator::pack() {
+
+    if (this->storage == TwoElectronStorage::packed) {
+        return;
+    }
+
+    if (this->storage == TwoElectronStorage::mixed) {
+        this->packed_elements = this->unmixPackedElements();
+        this->single_precision_elements = Eigen::VectorXf ();  // release the memory of the mixed elements
+        this->double_precision_elements = std::vector<std::pair<size_t, double>> ();
+        this->storage = TwoElectronStorage::packed;
+        return;
+    }
+
+
+    auto K = this->dim;
+    this->packed_elements = Eigen::VectorXd::Zero(TwoElectronOperator::numberOfPackedElements(K));
+
+    // Loop over the canonical elements p >= q, r >= s, pq >= rs
+    for (size_t p = 0; p < K; p++) {
+        for (size_t q = 0; q <= p; q++) {
+            for (size_t r = 0; r <= p; r++) {
+                for (size_t s = 0; s <= r; s++) {
+                    if (TwoElectronOperator::pairIndex(r, s) > TwoElectronOperator::pairIndex(p, q)) {
+                        break;
+                    }
+
+                    this->packed_elements(TwoElectronOperator::packedIndex(p, q, r, s)) = this->get(p, q, r, s);
+                }
+            }
+        }
+    }
+
+    this->tensor = Eigen::Tensor<double, 4> ();  // release the memory of the dense tensor
+    this->factors = Eigen::MatrixXd ();  // release the memory of the factors
+    this->storage = TwoElectronStorage::packed;
+}
+
+
+/**
+ *  Convert the matrix representation to the dense storage
+ */
+void TwoElectronOperator::unpack() {
+
+    if (this->storage == TwoElectronStorage::dense) {
+        return;
+    }
+
+    this->tensor = this->get_matrix_representation();
+    this->packed_elements = Eigen::VectorXd ();  // release the memory of the packed elements
+    this->factors = Eigen::MatrixXd ();  // release the memory of the factors
+    this->single_precision_elements = Eigen::VectorXf ();  // release the memory of the mixed elements
+    this->double_precision_elements = std::vector<std::pair<size_t, double>> ();
+    this->storage = TwoElectronStorage::dense;
+}
+
+
+/**
+ *  Convert the matrix representation to the mixed storage, in which every element has an absolute error of at most
+ *  the given @param error_bound
+ *
+ *  If the mixed storage wouldn't be smaller than the packed storage, the (exact) packed storage is kept instead
+ */
+void TwoElectronOperator::compress(double error_bound) {
+
+    if (error_bound <= 0.0) {
+        throw std::invalid_argument("The error bound for the mixed storage should be positive.");
+    }
+
+    this->pack();  // the mixed storage is based on the symmetry-unique elements
+
+
+    // Count the elements that should be kept in double precision first, so that we can keep the packed storage if the mixed one isn't smaller
+    auto number_of_elements = this->packed_elements.size();
+    size_t number_of_double_precision_elements = 0;
+    for (long i = 0; i < number_of_elements; i++) {
+        if (TwoElectronOperator::needsDoublePrecision(this->packed_elements(i), error_bound)) {
+            number_of_double_precision_elements++;
+        }
+    }
+
+    if (!TwoElectronOperator::isMixedStorageSmaller(static_cast<size_t>(number_of_elements), number_of_double_precision_elements)) {
+        return;
+    }
+
+
+    Eigen::VectorXf single_precision_elements (number_of_elements);
+    std::vector<std::pair<size_t, double>> double_precision_elements;
+    double_precision_elements.reserve(number_of_double_precision_elements);
+
+    for (long i = 0; i < number_of_elements; i++) {
+        double element = this->packed_elements(i);
+
+        if (TwoElectronOperator::needsDoublePrecision(element, error_bound)) {  // the rounding error could be too large
+            single_precision_elements(i) = TwoElectronOperator::correctedElement();
+            double_precision_elements.emplace_back(i, element);
+        } else {
+            single_precision_elements(i) = static_cast<float>(element);
+        }
+    }
+
+    this->packed_elements = Eigen::VectorXd ();  // release the memory of the packed elements
+    this->setMixedElements(std::move(single_precision_elements), std::move(double_precision_elements), error_bound);
+}
+
+
 /**
  *  Transform the matrix representation of a two-electron operator using the transformation matrix @param T
  *
  *  Note that the transformation matrix @param T is used as
  *      b' = b T ,
  *  in which the basis functions are collected as elements of a row vector b
+ *
+ *  The transformation matrix @param T can be rectangular (K x K'), e.g. to transform to a truncated orbital space:
+ *  the dimension of the operator then becomes K'
+ *
+ *  In the packed storage, the transformation is done without unpacking, using an intermediate of about K^2 K'^2/4 elements
+ *  In the mixed storage, the transformation is done in the same way, without forming the packed elements in double precision
  */
 void TwoElectronOperator::transform(const Eigen::MatrixXd& T) {
 
-    // Since we're only getting T as a matrix, we should make the appropriate tensor to perform contractions
-    // For the const Eigen::MatrixXd& argument, we need the const double in the template
-    //      For more info, see: https://stackoverflow.com/questions/45283468/eigen-const-tensormap
-    Eigen::TensorMap<Eigen::Tensor<const double, 2>> T_tensor (T.data(), T.rows(), T.cols());
+    this->transformInto(T, *this);
+}
+
+
+/**
+ *  @return the two-electron operator that is transformed with the transformation matrix @param T, in the same
+ *  storage, while this operator is left untouched
+ *
+ *  The untransformed elements are read directly from this operator instead of from a copy
+ */
+TwoElectronOperator TwoElectronOperator::transformed(const Eigen::MatrixXd& T) const {
+
+    TwoElectronOperator g_transformed (Eigen::Tensor<double, 4> (0, 0, 0, 0));  // its storage and elements are set by the transformation
+    this->transformInto(T, g_transformed);
+
+    return g_transformed;
+}
+
+
+/**
+ *  Transform the matrix representation of this two-electron operator using the transformation matrix @param T, and
+ *  store the result in @param g_transformed
+ *
+ *  @param g_transformed may be this operator itself, in which case the memory of the untransformed elements is
+ *  released as soon as it isn't needed anymore
+ */
+void TwoElectronOperator::transformInto(const Eigen::MatrixXd& T, TwoElectronOperator& g_transformed) const {
+
+    if (T.rows() != this->dim) {
+        throw std::invalid_argument("The number of rows of the transformation matrix should be the dimension of the operator.");
+    }
+
+
+    if (this->storage == TwoElectronStorage::packed) {
+        this->transformPacked(T, g_transformed);
+
+    } else if (this->storage == TwoElectronStorage::mixed) {
+        this->transformPacked(T, g_transformed);  // which reads and writes the mixed elements directly
+
+    } else if (this->storage == TwoElectronStorage::factorized) {
+        this->transformFactorized(T, g_transformed);
+
+    } else {
+        this->transformDense(T, g_transformed);
+    }
+
+    g_transformed.dim = static_cast<size_t>(T.cols());
+}
+
+
+/**
+ *  @return the symmetry-unique elements of the mixed matrix representation, in double precision
+ */
+Eigen::VectorXd TwoElectronOperator::unmixPackedElements() const {
+
+    Eigen::VectorXd elements = this->single_precision_elements.cast<double>();
+    for (const auto& element : this->double_precision_elements) {
+        elements(element.first) = element.second;
+    }
+
+    return elements;
+}
+
+
+/**
+ *  @return the symmetry-unique element with the given @param packed_index of the packed or mixed matrix representation
+ */
+double TwoElectronOperator::packedElement(size_t packed_index) const {
+
+    if (this->storage == TwoElectronStorage::packed) {
+        return this->packed_elements(packed_index);
+    }
+
+
+    // Only the double precision elements, which are marked by a NaN single precision element, have to be looked up in the (sorted) correction list
+    float single_precision_element = this->single_precision_elements(packed_index);
+    if (!std::isnan(single_precision_element)) {
+        return static_cast<double>(single_precision_element);
+    }
+
+    auto it = std::lower_bound(this->double_precision_elements.begin(), this->double_precision_elements.end(), packed_index,
+                               [] (const std::pair<size_t, double>& element, size_t index) { return element.first < index; });
+    return it->second;  // every marked element is in the correction list
+}
+
+
+/**
+ *  Set the mixed matrix representation to the given @param single_precision_elements and the (packed index, value)
+ *  @param double_precision_elements, which all have an absolute error of at most the given @param error_bound
+ *
+ *  If the mixed storage isn't smaller than the packed storage, the elements are converted to the packed storage (in
+ *  which they keep their error of at most the error bound)
+ */
+void TwoElectronOperator::setMixedElements(Eigen::VectorXf single_precision_elements, std::vector<std::pair<size_t, double>> double_precision_elements, double error_bound) {
+
+    if (!std::is_sorted(double_precision_elements.begin(), double_precision_elements.end())) {
+        std::sort(double_precision_elements.begin(), double_precision_elements.end());  // the packed indices are unique, so they are sorted by packed index
+    }
+
+    this->single_precision_elements = std::move(single_precision_elements);
+    this->double_precision_elements = std::move(double_precision_elements);
+    this->error_bound = error_bound;
+    this->storage = TwoElectronStorage::mixed;
+
+    if (!TwoElectronOperator::isMixedStorageSmaller(static_cast<size_t>(this->single_precision_elements.size()), this->double_precision_elements.size())) {
+        this->pack();
+    }
+}
+
+
+/**
+ *  Transform the dense matrix representation of a two-electron operator using the transformation matrix @param T,
+ *  and store the result in @param g_transformed (which may be this operator)
+ *
+ *  In column-major storage, every index can be transformed by a matrix-matrix product on contiguous memory, so we
+ *  perform four quarter-transformations (with K' the number of columns of T):
+ *      1) (p'q|rs) = sum_p T(p,p') (pq|rs): one product T^T X, with X a K x K^3 matrix
+ *      2) (p'q|rs') = sum_s (p'q|rs) T(s,s'): one product X T, with X a K'K^2 x K matrix
+ *      3) (p'q|r's') = sum_r (p'q|rs') T(r,r'): for every s', one product X T, with X a K'K x K matrix
+ *      4) (p'q'|r's') = sum_q (p'q|r's') T(q,q'): for every r's', one product X T, with X a K' x K matrix
+ *  The intermediates are kept in two scratch buffers, of which the first one is reused in step 3. If the tensor is
+ *  transformed in place, the untransformed tensor is released after step 1, before the second buffer is allocated, so
+ *  that at most two K^4 objects (for a square T) exist at the same time
+ */
+void TwoElectronOperator::transformDense(const Eigen::MatrixXd& T, TwoElectronOperator& g_transformed) const {
+
+    auto K = static_cast<long>(T.rows());
+    auto K_new = static_cast<long>(T.cols());
+
+    Eigen::VectorXd scratch1 (std::max(K_new * K*K*K, K_new * K * K_new*K_new));  // the intermediates of steps 1 and 3
+
+
+    // 1) Transform the first index
+    Eigen::Map<const Eigen::MatrixXd> g (this->tensor.data(), K, K*K*K);
+    Eigen::Map<Eigen::MatrixXd> X1 (scratch1.data(), K_new, K*K*K);
+    X1.noalias() = T.transpose() * g;
+
+    if (&g_transformed == this) {
+        g_transformed.tensor = Eigen::Tensor<double, 4> ();  // release the memory of the untransformed tensor
+    }
+
+
+    // 2) Transform the fourth index, in a buffer that is only allocated after the untransformed tensor is released
+    Eigen::VectorXd scratch2 (K_new * K*K * K_new);  // the intermediate of step 2
+    Eigen::Map<const Eigen::MatrixXd> X1_reshaped (scratch1.data(), K_new*K*K, K);
+    Eigen::Map<Eigen::MatrixXd> X2 (scratch2.data(), K_new*K*K, K_new);
+    X2.noalias() = X1_reshaped * T;
+
+
+    // 3) Transform the third index, for every transformed fourth index
+    for (long s = 0; s < K_new; s++) {
+        Eigen::Map<const Eigen::MatrixXd> X2_slice (scratch2.data() + s * K_new*K*K, K_new*K, K);
+        Eigen::Map<Eigen::MatrixXd> X3_slice (scratch1.data() + s * K_new*K*K_new, K_new*K, K_new);
+        X3_slice.noalias() = X2_slice * T;
+    }
+
+    scratch2 = Eigen::VectorXd ();  // release the memory of the intermediate of step 2
+
+
+    // 4) Transform the second index, for every transformed pair of the third and fourth index
+    Eigen::Tensor<double, 4> tensor_transformed (K_new, K_new, K_new, K_new);
+    for (long rs = 0; rs < K_new*K_new; rs++) {
+        Eigen::Map<const Eigen::MatrixXd> X3_slice (scratch1.data() + rs * K_new*K, K_new, K);
+        Eigen::Map<Eigen::MatrixXd> tensor_transformed_slice (tensor_transformed.data() + rs * K_new*K_new, K_new, K_new);
+        tensor_transformed_slice.noalias() = X3_slice * T;
+    }
+
+    g_transformed.tensor = std::move(tensor_transformed);
+    g_transformed.storage = TwoElectronStorage::dense;
+}
+
+
+/**
+ *  Transform the packed matrix representation of a two-electron operator using the transformation matrix @param T,
+ *  and store the result in @param g_transformed (which may be this operator)
+ *
+ *  We perform two half-transformations, each of which only works on symmetric K x K matrices:
+ *      1) for every pair pq: (pq|r's') = T^T (pq|rs) T, stored in an intermediate X(pq, r's') of K(K+1)/2 x K'(K'+1)/2 elements
+ *      2) for every pair r's': (p'q'|r's') = T^T (pq|r's') T, of which only the symmetry-unique elements are kept
+ *  Every column of the intermediate holds all the bra pairs of one transformed ket pair, so step 2 reads contiguous
+ *  memory without transposing the intermediate
+ *
+ *  The intermediate has about K^2 K'^2/4 elements, i.e. twice the untransformed packed elements for a square T. If the
+ *  elements are transformed in place, the untransformed elements are released after step 1, so the peak memory is
+ *  about K^4/8 + K^2 K'^2/4 doubles: three times the packed storage for a square T
+ *
+ *  In the mixed storage, the elements are read from the single precision elements and the correction list, and the
+ *  transformed elements are rounded again with the same error bound. A double precision intermediate would be four
+ *  times as large as the mixed storage, so both steps are done for batches of transformed ket pairs (r's') instead, of
+ *  which the intermediate is at most as large as the single precision elements. In step 1, only the rows r' of the
+ *  batch (and the columns s' <= r') of T^T (pq|rs) T are calculated, so the batches only repeat the reading of (pq|rs)
+ *  and a part of the product (pq|rs) T. The peak memory is then about three times the mixed storage (for a square T)
+ */
+void TwoElectronOperator::transformPacked(const Eigen::MatrixXd& T, TwoElectronOperator& g_transformed) const {
+
+    auto K = this->dim;
+    const bool is_mixed = (this->storage == TwoElectronStorage::mixed);
+    const auto error_bound = this->error_bound;
+    auto K_new = static_cast<size_t>(T.cols());
+    auto number_of_pairs = K * (K + 1) / 2;
+    auto number_of_pairs_new = K_new * (K_new + 1) / 2;
 
 
-    // We will have to do four single contractions, so we specify the contraction indices
-    // Eigen3 does not document its tensor contraction clearly, so see the accepted answer on stackoverflow (https://stackoverflow.com/a/47558349/7930415):
-    //      Eigen3 does not accept a way to specify the output axes: instead, it retains the order from left to right of the axes that survive the contraction.
-    //      This means that, in order to get the right ordering of the axes, we will have to swap axes
+    // The transformed elements are written in their final storage for every batch
+    auto number_of_elements_new = TwoElectronOperator::numberOfPackedElements(K_new);
 
-    // g(T U V W)  T^*(V R) -> a(T U R W) but we get a(T U W R)
-    Eigen::array<Eigen::IndexPair<int>, 1> contraction_pair1 = {Eigen::IndexPair<int>(2, 0)};
-    Eigen::array<int, 4> shuffle_1 {0, 1, 3, 2};
+    Eigen::VectorXd packed_elements_transformed;  // packed storage
+    Eigen::VectorXf single_precision_elements_transformed;  // mixed storage
+    std::vector<std::pair<size_t, double>> double_precision_elements_transformed;  // mixed storage
+    if (is_mixed) {
+        single_precision_elements_transformed = Eigen::VectorXf (number_of_elements_new);
+    }
+
+
+    // In the mixed storage, a batch holds so many ket pairs that its intermediate is at most as large as the single precision elements
+    size_t max_batch_pairs = number_of_pairs_new;
+    if (is_mixed) {
+        auto single_precision_bytes = TwoElectronOperator::numberOfPackedElements(K) * sizeof(float);
+        max_batch_pairs = std::max<size_t>(1, single_precision_bytes / std::max<size_t>(1, number_of_pairs * sizeof(double)));
+    }
+
+    Eigen::MatrixXd X;  // the intermediate X(pq, r's') for the ket pairs of one batch
+    Eigen::MatrixXd M (K, K);  // the symmetric matrix of the ket (or bra) indices for one bra (or transformed ket) pair
+    Eigen::MatrixXd MT (K, K_new);  // scratch matrix for M T
+    Eigen::MatrixXd M_transformed (K_new, K_new);
+
+    size_t r_end = 0;
+    while (r_end < K_new) {
+
+        // Find the rows r' of the next batch: its ket pairs r's' (with s' <= r') are contiguous in the pair index
+        size_t r_begin = r_end;
+        auto first_pair = TwoElectronOperator::pairIndex(r_begin, 0);
+        do {
+            r_end++;
+        } while ((r_end < K_new) && (r_end * (r_end + 1) / 2 + r_end + 1 - first_pair <= max_batch_pairs));
+
+        auto batch_rows = r_end - r_begin;
+        auto batch_pairs = r_end * (r_end + 1) / 2 - first_pair;
+        X.resize(number_of_pairs, batch_pairs);
+
+
+        // 1) Transform the ket indices (rs) for every bra pair (pq), only for the rows r' of this batch
+        auto T_columns = T.leftCols(r_end);  // s' <= r' < r_end
+        auto T_batch = T.middleCols(r_begin, batch_rows);
+
+        for (size_t p = 0; p < K; p++) {
+            for (size_t q = 0; q <= p; q++) {
+                for (size_t r = 0; r < K; r++) {
+                    for (size_t s = 0; s <= r; s++) {
+                        M(r, s) = this->packedElement(TwoElectronOperator::packedIndex(p, q, r, s));
+                        M(s, r) = M(r, s);
+                    }
+                }
+
+                MT.leftCols(r_end).noalias() = M * T_columns;
+                M_transformed.topLeftCorner(batch_rows, r_end).noalias() = T_batch.transpose() * MT.leftCols(r_end);
+
+                auto pq = TwoElectronOperator::pairIndex(p, q);
+                for (size_t r = r_begin; r < r_end; r++) {
+                    for (size_t s = 0; s <= r; s++) {
+                        X(pq, TwoElectronOperator::pairIndex(r, s) - first_pair) = M_transformed(r - r_begin, s);
+                    }
+                }
+            }
+        }
+
+        if ((&g_transformed == this) && (r_end == K_new)) {  // the last batch has read the untransformed elements, so their memory can be released
+            g_transformed.packed_elements = Eigen::VectorXd ();
+            g_transformed.single_precision_elements = Eigen::VectorXf ();
+            g_transformed.double_precision_elements = std::vector<std::pair<size_t, double>> ();
+        }
+        if (!is_mixed) {  // in the packed storage, there is only one batch, so the transformed elements are allocated after the untransformed ones are released
+            packed_elements_transformed.resize(number_of_elements_new);
+        }
+
+
+        // 2) Transform the bra indices (pq) for every transformed ket pair (r's') of this batch
+        for (size_t r = r_begin; r < r_end; r++) {
+            for (size_t s = 0; s <= r; s++) {
+                auto rs = TwoElectronOperator::pairIndex(r, s);
+
+                for (size_t p = 0; p < K; p++) {
+                    for (size_t q = 0; q <= p; q++) {
+                        M(p, q) = X(TwoElectronOperator::pairIndex(p, q), rs - first_pair);
+                        M(q, p) = M(p, q);
+                    }
+                }
+
+                MT.noalias() = M * T;
+                M_transformed.noalias() = T.transpose() * MT;
+
+                // Only keep the symmetry-unique elements, i.e. those with pq >= rs
+                for (size_t p = r; p < K_new; p++) {
+                    for (size_t q = 0; q <= p; q++) {
+                        auto pq = TwoElectronOperator::pairIndex(p, q);
+                        if (pq < rs) {
+                            continue;
+                        }
+
+                        auto index = TwoElectronOperator::pairIndex(pq, rs);
+                        double element = M_transformed(p, q);
+                        if (!is_mixed) {
+                            packed_elements_transformed(index) = element;
+                        } else if (TwoElectronOperator::needsDoublePrecision(element, error_bound)) {
+                            single_precision_elements_transformed(index) = TwoElectronOperator::correctedElement();
+                            double_precision_elements_transformed.emplace_back(index, element);
+                        } else {
+                            single_precision_elements_transformed(index) = static_cast<float>(element);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    g_transformed.dim = K_new;  // setMixedElements() may pack the elements, which needs the new dimension
+    if (is_mixed) {
+        g_transformed.setMixedElements(std::move(single_precision_elements_transformed), std::move(double_precision_elements_transformed), error_bound);
+    } else {
+        g_transformed.packed_elements = std::move(packed_elements_transformed);
+        g_transformed.storage = TwoElectronStorage::packed;
+        g_transformed.error_bound = 0.0;
+    }
+}
 
-    // a(T U R W)  T(W S) -> b(T U R S) and we get b(T U R S), so no shuffle is needed
-    Eigen::array<Eigen::IndexPair<int>, 1> contraction_pair2 = {Eigen::IndexPair<int>(3, 0)};
 
-    // T(U Q)  b(T U R S) -> c(T Q R S) but we get c(Q T R S)
-    Eigen::array<Eigen::IndexPair<int>, 1> contraction_pair3 = {Eigen::IndexPair<int>(0, 1)};
-    Eigen::array<int, 4> shuffle_3 {1, 0, 2, 3};
+/**
+ *  Transform the factorized matrix representation of a two-electron operator using the transformation matrix @param T,
+ *  and store the result in @param g_transformed (which may be this operator)
+ *
+ *  Every factor is transformed as L^L' = T^T L^L T, which are two matrix-matrix products per factor
+ */
+void TwoElectronOperator::transformFactorized(const Eigen::MatrixXd& T, TwoElectronOperator& g_transformed) const {
 
-    // T^*(T P)  c(T Q R S) -> g'(P Q R S) and we get g_SO(p q r s), so no shuffle is needed
-    Eigen::array<Eigen::IndexPair<int>, 1> contraction_pair4 = {Eigen::IndexPair<int>(0, 0)};
+    auto K = static_cast<long>(this->dim);
+    auto K_new = static_cast<long>(T.cols());
 
+    Eigen::MatrixXd factors_transformed (K_new*K_new, this->factors.cols());
+    Eigen::MatrixXd LT (K, K_new);  // scratch matrix for L^L T
 
-    // Calculate the contractions. We write this as one large contraction to
-    //  1) avoid storing intermediate contractions
-    //  2) let Eigen3 figure out some optimizations
-    Eigen::Tensor<double, 4> g_transformed = T_tensor.conjugate().contract(T_tensor.contract(this->tensor.contract(T_tensor.conjugate(), contraction_pair1).shuffle(shuffle_1).contract(T_tensor, contraction_pair2), contraction_pair3).shuffle(shuffle_3), contraction_pair4);
+    for (long L = 0; L < this->factors.cols(); L++) {
+        Eigen::Map<const Eigen::MatrixXd> factor (this->factors.col(L).data(), K, K);
+        Eigen::Map<Eigen::MatrixXd> factor_transformed (factors_transformed.col(L).data(), K_new, K_new);
+
+        LT.noalias() = factor * T;
+        factor_transformed.noalias() = T.transpose() * LT;
+    }
 
-    this->tensor = g_transformed;
+    g_transformed.factors = std::move(factors_transformed);
+    g_transformed.storage = TwoElectronStorage::factorized;
+}
+
+
+/**
+ *  @return the (packed index, value) of the symmetry-unique elements of the packed or mixed matrix representation
+ *  that change under the Jacobi rotation @param jacobi of the orbitals @param p and @param q
+ *
+ *  Only the symmetry-unique elements with at least one index in {p, q} change. Every one of them is equivalent to an
+ *  element (ab|cd) with a in {p, q} and c >= d, and is a combination of at most 16 untransformed elements, which is
+ *  O(K^3) work in total. Note that some elements appear more than once, with the same value
+ */
+std::vector<std::pair<size_t, double>> TwoElectronOperator::rotatedElements(size_t p, size_t q, const Eigen::JacobiRotation<double>& jacobi) const {
+
+    // The 2x2 block of the Jacobi rotation matrix J that mixes p and q, i.e. (J_pp J_pq; J_qp J_qq)
+    Eigen::Matrix2d J_pq = Eigen::Matrix2d::Identity();
+    J_pq.applyOnTheRight(0, 1, jacobi);
+
+    // The number of untransformed indices y that contribute to the transformed index x, with their coefficients J_yx
+    auto contributions = [p, q, &J_pq] (size_t x, size_t indices[2], double coefficients[2]) {
+        if ((x != p) && (x != q)) {
+            indices[0] = x;
+            coefficients[0] = 1.0;
+            return 1;
+        }
+
+        auto column = (x == p) ? 0 : 1;
+        indices[0] = p;
+        indices[1] = q;
+        coefficients[0] = J_pq(0, column);
+        coefficients[1] = J_pq(1, column);
+        return 2;
+    };
+
+
+    auto K = this->dim;
+    std::vector<std::pair<size_t, double>> rotated_elements;  // the (packed index, value) of the changed elements
+    rotated_elements.reserve(2 * K * K*(K+1)/2);
+
+    size_t indices[4][2];
+    double coefficients[4][2];
+    for (auto a : {p, q}) {
+        auto n_a = contributions(a, indices[0], coefficients[0]);
+
+        for (size_t b = 0; b < K; b++) {
+            auto n_b = contributions(b, indices[1], coefficients[1]);
+
+            for (size_t c = 0; c < K; c++) {
+                auto n_c = contributions(c, indices[2], coefficients[2]);
+
+                for (size_t d = 0; d <= c; d++) {
+                    auto n_d = contributions(d, indices[3], coefficients[3]);
+
+                    double value = 0.0;
+                    for (int i = 0; i < n_a; i++) {
+                        for (int j = 0; j < n_b; j++) {
+                            for (int k = 0; k < n_c; k++) {
+                                for (int l = 0; l < n_d; l++) {
+                                    value += coefficients[0][i] * coefficients[1][j] * coefficients[2][k] * coefficients[3][l]
+                                             * this->packedElement(TwoElectronOperator::packedIndex(indices[0][i], indices[1][j], indices[2][k], indices[3][l]));
+                                }
+                            }
+                        }
+                    }
+
+                    rotated_elements.emplace_back(TwoElectronOperator::packedIndex(a, b, c, d), value);
+                }
+            }
+        }
+    }
+
+    return rotated_elements;
+}
+
+
+/**
+ *  Rotate the packed or mixed matrix representation of a two-electron operator in-place with the Jacobi rotation
+ *  @param jacobi of the orbitals @param p and @param q
+ *
+ *  The rotated elements are collected first, so that no untransformed element is overwritten too early. In the mixed
+ *  storage, every rotated element is rounded again, and the rotated elements that need double precision are merged
+ *  with the unchanged ones in the (sorted) correction list
+ */
+void TwoElectronOperator::rotatePacked(size_t p, size_t q, const Eigen::JacobiRotation<double>& jacobi) {
+
+    auto rotated_elements = this->rotatedElements(p, q, jacobi);
+
+    if (this->storage == TwoElectronStorage::packed) {
+        for (const auto& element : rotated_elements) {
+            this->packed_elements(element.first) = element.second;
+        }
+        return;
+    }
+
+
+    // Sort the rotated elements by their packed index, so that they can be merged with the correction list
+    auto has_smaller_index = [] (const std::pair<size_t, double>& element1, const std::pair<size_t, double>& element2) { return element1.first < element2.first; };
+    auto has_same_index = [] (const std::pair<size_t, double>& element1, const std::pair<size_t, double>& element2) { return element1.first == element2.first; };
+    std::sort(rotated_elements.begin(), rotated_elements.end(), has_smaller_index);
+    rotated_elements.erase(std::unique(rotated_elements.begin(), rotated_elements.end(), has_same_index), rotated_elements.end());
+
+    std::vector<std::pair<size_t, double>> double_precision_elements;
+    double_precision_elements.reserve(this->double_precision_elements.size());
+
+    auto it = this->double_precision_elements.begin();  // the next unmerged element of the correction list
+    for (const auto& element : rotated_elements) {
+        for (; (it != this->double_precision_elements.end()) && (it->first < element.first); it++) {  // these elements haven't changed
+            double_precision_elements.push_back(*it);
+        }
+        if ((it != this->double_precision_elements.end()) && (it->first == element.first)) {  // this element has changed
+            it++;
+        }
+
+        if (TwoElectronOperator::needsDoublePrecision(element.second, this->error_bound)) {
+            this->single_precision_elements(element.first) = TwoElectronOperator::correctedElement();
+            double_precision_elements.push_back(element);
+        } else {
+            this->single_precision_elements(element.first) = static_cast<float>(element.second);
+        }
+    }
+    double_precision_elements.insert(double_precision_elements.end(), it, this->double_precision_elements.end());
+
+    this->setMixedElements(std::move(this->single_precision_elements), std::move(double_precision_elements), this->error_bound);
 }
 
 
@@ -101,15 +842,49 @@ void TwoElectronOperator::rotate(const Eigen::MatrixXd& U) {
  */
 void TwoElectronOperator::rotate(const GQCG::JacobiRotationParameters& jacobi_rotation_parameters) {
 
-    /**
-     *  While waiting for an analogous Eigen::Tensor Jacobi module, we implement this rotation by constructing a
-     *  Jacobi rotation matrix and then doing a rotation with it
-     */
+    auto p = jacobi_rotation_parameters.get_p();
+    auto q = jacobi_rotation_parameters.get_q();
+
+    // Use Eigen's Jacobi module to apply the Jacobi rotation directly (cfr. T.adjoint() * M * T for every index)
+    Eigen::JacobiRotation<double> jacobi (std::cos(jacobi_rotation_parameters.get_angle()), std::sin(jacobi_rotation_parameters.get_angle()));
+    auto K = static_cast<long>(this->dim);
+
 
-    auto dim = static_cast<size_t>(this->tensor.dimension(0));  // .dimension() returns a long
-    Eigen::MatrixXd J = jacobiRotationMatrix(jacobi_rotation_parameters, dim);
+    if (this->storage == TwoElectronStorage::factorized) {
 
-    this->rotate(J);
+        // Apply the Jacobi rotation directly to the rows and columns p and q of every factor
+        for (long L = 0; L < this->factors.cols(); L++) {
+            Eigen::Map<Eigen::MatrixXd> factor (this->factors.col(L).data(), K, K);
+
+            factor.applyOnTheLeft(p, q, jacobi.adjoint());
+            factor.applyOnTheRight(p, q, jacobi);
+        }
+
+    } else if ((this->storage == TwoElectronStorage::packed) || (this->storage == TwoElectronStorage::mixed)) {
+        this->rotatePacked(p, q, jacobi);
+
+    } else {
+
+        // A Jacobi rotation only mixes the slices p and q of every index, so we rotate them in-place, one index at a
+        // time, on column-major views of the tensor: this is O(K^3) instead of the O(K^5) of a full transformation
+        double* data = this->tensor.data();
+
+        // The first index: the rows p and q of the K x K^3 matrix
+        Eigen::Map<Eigen::MatrixXd> (data, K, K*K*K).applyOnTheLeft(p, q, jacobi.adjoint());
+
+        // The second index: the columns p and q of the K x K matrix for every pair of the third and fourth index
+        for (long rs = 0; rs < K*K; rs++) {
+            Eigen::Map<Eigen::MatrixXd> (data + rs * K*K, K, K).applyOnTheRight(p, q, jacobi);
+        }
+
+        // The third index: the columns p and q of the K^2 x K matrix for every fourth index
+        for (long s = 0; s < K; s++) {
+            Eigen::Map<Eigen::MatrixXd> (data + s * K*K*K, K*K, K).applyOnTheRight(p, q, jacobi);
+        }
+
+        // The fourth index: the columns p and q of the K^3 x K matrix
+        Eigen::Map<Eigen::MatrixXd> (data, K*K*K, K).applyOnTheRight(p, q, jacobi);
+    }
 }
 
 
@@ -25,3 +25,62 @@ BOOST_AUTO_TEST_CASE ( number_of_basis_functions ) {
 
     BOOST_CHECK_EQUAL(basis.get_number_of_basis_functions(), 7);
 }
+
+
+BOOST_AUTO_TEST_CASE ( basis_set_name ) {
+
+    GQCG::Molecule water ("../tests/data/h2o.xyz");
+    GQCG::AOBasis basis (water, "STO-3G");
+
+    BOOST_CHECK_EQUAL(basis.get_basis_set_name(), "STO-3G");
+}
+
+
+BOOST_AUTO_TEST_CASE ( recentering_constructor ) {
+
+    std::vector<GQCG::Atom> atoms = {
+        {8, 0.0, 0.0, 0.0},
+        {1, 0.0, 1.4, -1.0},
+        {1, 0.0, -1.4, -1.0}
+    };
+    std::vector<GQCG::Atom> displaced_atoms = {
+        {8, 0.0, 0.1, 0.2},
+        {1, 0.0, 1.5, -0.9},
+        {1, 0.3, -1.4, -1.1}
+    };
+
+    GQCG::AOBasis basis (GQCG::Molecule(atoms), "STO-3G");
+    GQCG::AOBasis displaced_basis (GQCG::Molecule(displaced_atoms), "STO-3G");
+
+
+    // Check if recentering a basis gives the same basis as constructing it at the new positions
+    GQCG::AOBasis recentered_basis (basis, displaced_atoms);
+    BOOST_CHECK(recentered_basis.get_atoms() == displaced_atoms);
+    BOOST_CHECK_EQUAL(recentered_basis.get_number_of_basis_functions(), displaced_basis.get_number_of_basis_functions());
+    BOOST_CHECK(recentered_basis.get_schwarz_bounds().isApprox(displaced_basis.get_schwarz_bounds(), 1.0e-12));
+
+    // Check if the given basis is left untouched
+    BOOST_CHECK(basis.get_atoms() == atoms);
+
+
+    // Check if the atoms should correspond to the ones of the basis
+    BOOST_CHECK_THROW(GQCG::AOBasis (basis, {{8, 0.0, 0.0, 0.0}}), std::invalid_argument);
+    BOOST_CHECK_THROW(GQCG::AOBasis (basis, {{8, 0.0, 0.0, 0.0}, {1, 0.0, 1.4, -1.0}, {2, 0.0, -1.4, -1.0}}), std::invalid_argument);
+}
+
+
+BOOST_AUTO_TEST_CASE ( schwarz_bounds_copy ) {
+
+    GQCG::Molecule water ("../tests/data/h2o.xyz");
+    GQCG::AOBasis basis (water, "STO-3G");
+    GQCG::AOBasis copy_before (basis);  // the Schwarz bounds haven't been calculated yet
+
+    const auto& schwarz_bounds = basis.get_schwarz_bounds();
+    GQCG::AOBasis copy_after (basis);  // the calculated Schwarz bounds are copied
+
+
+    // Check if the lazily calculated Schwarz bounds don't depend on when the basis was copied
+    BOOST_CHECK_EQUAL(schwarz_bounds.rows(), 5);  // water in STO-3G has 5 shells
+    BOOST_CHECK(copy_before.get_schwarz_bounds().isApprox(schwarz_bounds, 1.0e-12));
+    BOOST_CHECK(copy_after.get_schwarz_bounds().isApprox(schwarz_bounds, 1.0e-12));
+}
@@ -0,0 +1,93 @@
+#define BOOST_TEST_MODULE "BasisSetLibrary"
+
+
+#include "BasisSetLibrary.hpp"
+
+#include "AOBasis.hpp"
+#include "LibintCommunicator.hpp"
+
+#include <thread>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/test/included/unit_test.hpp>  // include this to get main(), otherwise the compiler will complain
+
+
+
+BOOST_AUTO_TEST_CASE ( cached_element_bases ) {
+
+    auto& library = GQCG::BasisSetLibrary::get();
+    library.clear();
+    BOOST_CHECK_EQUAL(library.numberOfCachedBasisSets(), 0);
+
+
+    // A basis set is only read once, also for names that are canonicalized to the same name
+    auto element_bases = library.elementBases("STO-3G");
+    BOOST_CHECK_EQUAL(library.numberOfCachedBasisSets(), 1);
+    BOOST_CHECK_EQUAL(library.elementBases("STO-3G").get(), element_bases.get());
+    BOOST_CHECK_EQUAL(library.elementBases("sto-3g").get(), element_bases.get());
+    BOOST_CHECK_EQUAL(library.numberOfCachedBasisSets(), 1);
+
+    library.elementBases("6-31G");
+    BOOST_CHECK_EQUAL(library.numberOfCachedBasisSets(), 2);
+}
+
+
+BOOST_AUTO_TEST_CASE ( basis_set ) {
+
+    GQCG::Molecule water ("../tests/data/h2o.xyz");
+    GQCG::AOBasis ao_basis (water, "STO-3G");
+    auto libint_atoms = GQCG::LibintCommunicator::get().interface(ao_basis.get_atoms());
+    BOOST_CHECK_EQUAL(ao_basis.get_number_of_basis_functions(), 7);
+
+
+    // Check if the basis set that is assembled from the cache is the same as the one libint2 reads, also for the basis
+    // sets that use Cartesian d-shells by convention (the 3-21G and 6-31G families) and the ones that don't (6-311G)
+    for (const std::string basis_set_name : {"STO-3G", "3-21G", "6-31G*", "6-31G**", "6-311G**"}) {
+
+        libint2::BasisSet ref_basisset (basis_set_name, libint_atoms);
+        auto basisset = GQCG::BasisSetLibrary::get().basisSet(basis_set_name, libint_atoms);
+
+        BOOST_CHECK_EQUAL(basisset.nbf(), ref_basisset.nbf());
+        BOOST_REQUIRE_EQUAL(basisset.size(), ref_basisset.size());
+        for (size_t sh = 0; sh < basisset.size(); sh++) {
+            BOOST_CHECK(basisset[sh] == ref_basisset[sh]);  // compares the exponents, the contractions (including l and the pure flag) and the origin
+        }
+    }
+
+    BOOST_CHECK_EQUAL(GQCG::BasisSetLibrary::get().basisSet("6-31G*", libint_atoms).nbf(), 19);  // 6 Cartesian d-functions on O
+    BOOST_CHECK_EQUAL(GQCG::BasisSetLibrary::get().basisSet("6-311G**", libint_atoms).nbf(), 30);  // 5 pure d-functions on O
+}
+
+
+BOOST_AUTO_TEST_CASE ( concurrent_basis_sets ) {
+
+    auto& library = GQCG::BasisSetLibrary::get();
+    library.clear();
+
+    GQCG::Molecule water ("../tests/data/h2o.xyz");
+    auto libint_atoms = GQCG::LibintCommunicator::get().interface(GQCG::AOBasis(water, "STO-3G").get_atoms());
+
+
+    // Construct basis sets on several threads at the same time: they should all share the same element bases
+    size_t number_of_threads = 4;
+    std::vector<std::shared_ptr<const GQCG::BasisSetLibrary::ElementBases>> element_bases (number_of_threads);
+    std::vector<long> nbfs (number_of_threads);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < number_of_threads; i++) {
+        threads.emplace_back([&, i] () {
+            for (size_t j = 0; j < 10; j++) {
+                element_bases[i] = library.elementBases("STO-3G");
+                nbfs[i] = library.basisSet("STO-3G", libint_atoms).nbf();
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    for (size_t i = 0; i < number_of_threads; i++) {
+        BOOST_CHECK_EQUAL(element_bases[i].get(), element_bases[0].get());
+        BOOST_CHECK_EQUAL(nbfs[i], 7);
+    }
+    BOOST_CHECK_EQUAL(library.numberOfCachedBasisSets(), 1);
+}
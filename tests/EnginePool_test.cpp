@@ -0,0 +1,79 @@
+#define BOOST_TEST_MODULE "EnginePool"
+
+
+#include "EnginePool.hpp"
+
+#include <thread>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/test/included/unit_test.hpp>  // include this to get main(), otherwise the compiler will complain
+
+
+
+BOOST_AUTO_TEST_CASE ( checkout_and_return ) {
+
+    libint2::initialize();
+
+    GQCG::EnginePool pool;
+    BOOST_CHECK_EQUAL(pool.numberOfIdleEngines(), 0);
+
+    libint2::Engine* first_engine;
+    {
+        auto engine = pool.checkout(libint2::Operator::overlap, 3, 1);
+        first_engine = &(*engine);
+        BOOST_CHECK_EQUAL(pool.numberOfIdleEngines(), 0);
+    }
+    BOOST_CHECK_EQUAL(pool.numberOfIdleEngines(), 1);  // the engine has been returned
+
+
+    // An engine with the same key is reused, an engine with another key is constructed
+    {
+        auto engine = pool.checkout(libint2::Operator::overlap, 3, 1);
+        BOOST_CHECK_EQUAL(&(*engine), first_engine);
+
+        auto other_engine = pool.checkout(libint2::Operator::kinetic, 3, 1);
+        BOOST_CHECK(&(*other_engine) != first_engine);
+        BOOST_CHECK_EQUAL(pool.numberOfIdleEngines(), 0);
+    }
+    BOOST_CHECK_EQUAL(pool.numberOfIdleEngines(), 2);
+
+
+    // A moved-from lease doesn't return anything
+    {
+        auto engine = pool.checkout(libint2::Operator::overlap, 3, 1);
+        auto moved_engine = std::move(engine);
+    }
+    BOOST_CHECK_EQUAL(pool.numberOfIdleEngines(), 2);
+
+    pool.clear();
+    BOOST_CHECK_EQUAL(pool.numberOfIdleEngines(), 0);
+
+    libint2::finalize();
+}
+
+
+BOOST_AUTO_TEST_CASE ( concurrent_checkouts ) {
+
+    libint2::initialize();
+
+    GQCG::EnginePool pool;
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < 8; i++) {
+        threads.emplace_back([&pool] () {
+            for (size_t j = 0; j < 100; j++) {
+                auto engine = pool.checkout(libint2::Operator::coulomb, 3, 1);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    // Every thread holds at most one engine at a time
+    BOOST_CHECK(pool.numberOfIdleEngines() >= 1);
+    BOOST_CHECK(pool.numberOfIdleEngines() <= 8);
+
+    pool.clear();
+    libint2::finalize();
+}
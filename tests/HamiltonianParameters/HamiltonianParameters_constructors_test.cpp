@@ -3,6 +3,9 @@
 
 #include "HamiltonianParameters/HamiltonianParameters_constructors.hpp"
 
+#include <cpputil.hpp>
+
+#include "miscellaneous.hpp"
 
 #include <boost/test/unit_test.hpp>
 #include <boost/test/included/unit_test.hpp>  // include this to get main(), otherwise the compiler will complain
@@ -19,3 +22,81 @@ BOOST_AUTO_TEST_CASE ( constructMolecularHamiltonianParameters ) {
     // Check if we can construct the molecular Hamiltonian parameters
     auto mol_ham_par = GQCG::constructMolecularHamiltonianParameters(ao_basis_sptr);
 }
+
+
+BOOST_AUTO_TEST_CASE ( constructCholeskyMolecularHamiltonianParameters ) {
+
+    // Set up a basis
+    GQCG::Molecule water ("../tests/data/h2o.xyz");
+    auto ao_basis_sptr = std::make_shared<GQCG::AOBasis>(water, "STO-3G");
+    auto K = ao_basis_sptr->get_number_of_basis_functions();
+
+
+    // Check if the Cholesky-decomposed Hamiltonian parameters can be rotated, and give the same result as the dense ones
+    auto mol_ham_par = GQCG::constructMolecularHamiltonianParameters(ao_basis_sptr);
+    auto mol_ham_par_cholesky = GQCG::constructCholeskyMolecularHamiltonianParameters(ao_basis_sptr, 1.0e-10);
+    BOOST_CHECK(mol_ham_par_cholesky.get_g().get_storage() == GQCG::TwoElectronStorage::factorized);
+
+    auto U = GQCG::jacobiRotationMatrix(GQCG::JacobiRotationParameters(4, 1, 0.37), K);
+    mol_ham_par.rotate(U);
+    mol_ham_par_cholesky.rotate(U);
+
+    BOOST_CHECK(cpputil::linalg::areEqual(mol_ham_par_cholesky.get_g().get_matrix_representation(), mol_ham_par.get_g().get_matrix_representation(), 1.0e-08));
+}
+
+
+BOOST_AUTO_TEST_CASE ( constructDensityFittedMolecularHamiltonianParameters ) {
+
+    // Set up a basis and an auxiliary basis
+    GQCG::Molecule water ("../tests/data/h2o.xyz");
+    auto ao_basis_sptr = std::make_shared<GQCG::AOBasis>(water, "STO-3G");
+    auto auxiliary_basis_sptr = std::make_shared<GQCG::AOBasis>(water, "cc-pVDZ-RI");
+
+
+    // Check if the density-fitted Hamiltonian parameters only differ from the dense ones in their two-electron integrals
+    auto mol_ham_par = GQCG::constructMolecularHamiltonianParameters(ao_basis_sptr);
+    auto mol_ham_par_fitted = GQCG::constructDensityFittedMolecularHamiltonianParameters(ao_basis_sptr, auxiliary_basis_sptr);
+    BOOST_CHECK(mol_ham_par_fitted.get_g().get_storage() == GQCG::TwoElectronStorage::factorized);
+
+    BOOST_CHECK(mol_ham_par_fitted.get_S().get_matrix_representation().isApprox(mol_ham_par.get_S().get_matrix_representation(), 1.0e-12));
+    BOOST_CHECK(mol_ham_par_fitted.get_h().get_matrix_representation().isApprox(mol_ham_par.get_h().get_matrix_representation(), 1.0e-12));
+}
+
+
+BOOST_AUTO_TEST_CASE ( visitMolecularHamiltonianParameters ) {
+
+    std::vector<std::vector<GQCG::Atom>> trajectory = {
+        {{8, 0.0, 0.0, 0.0}, {1, 0.0, 1.4, -1.0}, {1, 0.0, -1.4, -1.0}},
+        {{8, 0.0, 0.0, 0.1}, {1, 0.0, 1.5, -1.0}, {1, 0.0, -1.3, -1.1}},
+        {{8, 0.1, 0.0, 0.2}, {1, 0.0, 1.6, -0.9}, {1, 0.1, -1.2, -1.2}}
+    };
+    auto ao_basis_sptr = std::make_shared<GQCG::AOBasis>(GQCG::Molecule(trajectory[0]), "STO-3G");
+
+
+    // Check if every frame gives the same Hamiltonian parameters as a newly constructed basis, for both storages in which the two-electron integrals are recalculated in place
+    for (const auto storage : {GQCG::TwoElectronStorage::dense, GQCG::TwoElectronStorage::packed}) {
+
+        size_t number_of_visited_frames = 0;
+        GQCG::visitMolecularHamiltonianParameters(ao_basis_sptr, trajectory, [&] (size_t frame, const GQCG::HamiltonianParameters& ham_par) {
+
+            auto frame_basis_sptr = std::make_shared<GQCG::AOBasis>(GQCG::Molecule(trajectory[frame]), "STO-3G");
+            auto ref_ham_par = GQCG::constructMolecularHamiltonianParameters(frame_basis_sptr);
+
+            BOOST_CHECK(ham_par.get_g().get_storage() == storage);
+            BOOST_CHECK(ham_par.get_S().get_matrix_representation().isApprox(ref_ham_par.get_S().get_matrix_representation(), 1.0e-12));
+            BOOST_CHECK(ham_par.get_h().get_matrix_representation().isApprox(ref_ham_par.get_h().get_matrix_representation(), 1.0e-12));
+            BOOST_CHECK(cpputil::linalg::areEqual(ham_par.get_g().get_matrix_representation(), ref_ham_par.get_g().get_matrix_representation(), 1.0e-12));
+
+            number_of_visited_frames++;
+        }, storage);
+
+        BOOST_CHECK_EQUAL(number_of_visited_frames, trajectory.size());
+        BOOST_CHECK(ao_basis_sptr->get_atoms() == trajectory[0]);  // the given basis is never recentered
+    }
+
+
+    // Check if an invalid frame throws
+    trajectory.push_back({{8, 0.0, 0.0, 0.0}});
+    BOOST_CHECK_THROW(GQCG::visitMolecularHamiltonianParameters(ao_basis_sptr, trajectory, [] (size_t, const GQCG::HamiltonianParameters&) {}), std::invalid_argument);
+    BOOST_CHECK(ao_basis_sptr->get_atoms() == trajectory[0]);
+}
@@ -2,7 +2,12 @@
 
 
 #include "HamiltonianParameters/HamiltonianParameters.hpp"
+#include "HamiltonianParameters/HamiltonianParameters_constructors.hpp"
 
+#include <cpputil.hpp>
+
+#include "miscellaneous.hpp"
+#include "test_utilities.hpp"
 
 #include <boost/test/unit_test.hpp>
 #include <boost/test/included/unit_test.hpp>  // include this to get main(), otherwise the compiler will complain
@@ -12,8 +17,7 @@
 BOOST_AUTO_TEST_CASE ( HamiltonianParameters_constructor ) {
 
     // Create an AOBasis
-    GQCG::Molecule water ("../tests/data/h2o.xyz");
-    auto ao_basis_ptr = std::make_shared<GQCG::AOBasis>(water, "STO-3G");
+    auto ao_basis_ptr = waterSTO3GBasis();
 
 
     // Create One- and TwoElectronOperators (and a transformation matrix) with compatible dimensions
@@ -47,3 +51,215 @@ BOOST_AUTO_TEST_CASE ( HamiltonianParameters_constructor ) {
     BOOST_CHECK_THROW(GQCG::HamiltonianParameters (ao_basis_ptr, S, H_core, g_faulty, C), std::invalid_argument);
     BOOST_CHECK_THROW(GQCG::HamiltonianParameters (ao_basis_ptr, S, H_core, g, C_faulty), std::invalid_argument);
 }
+
+
+BOOST_AUTO_TEST_CASE ( HamiltonianParameters_constructor_no_copies ) {
+
+    // Create the operators of random Hamiltonian parameters
+    auto ao_basis_ptr = waterSTO3GBasis();
+    size_t K = ao_basis_ptr->get_number_of_basis_functions();
+
+    auto random_ham_par = randomHamiltonianParameters(ao_basis_ptr);
+    auto S = random_ham_par.get_S();
+    auto H_core = random_ham_par.get_h();
+    auto g = random_ham_par.get_g();
+    Eigen::MatrixXd C = random_ham_par.get_C();
+
+    const double* S_data = S.get_matrix().data();
+    const double* H_core_data = H_core.get_matrix().data();
+    const double* g_data = g.get_tensor().data();
+    const double* C_data = C.data();
+
+
+    // Check if moving the operators into the Hamiltonian parameters, and moving those, doesn't allocate (i.e. copy) any
+    // Eigen object: Eigen asserts if the test code allocates while this isn't allowed. The library itself is built
+    // without these checks, so the moved buffers should also be the ones that end up in the Hamiltonian parameters
+    Eigen::internal::set_is_malloc_allowed(false);
+    GQCG::HamiltonianParameters ham_par (ao_basis_ptr, std::move(S), std::move(H_core), std::move(g), std::move(C));
+    GQCG::HamiltonianParameters moved_ham_par (std::move(ham_par));
+    Eigen::internal::set_is_malloc_allowed(true);
+
+    BOOST_CHECK_EQUAL(moved_ham_par.get_g().get_tensor().dimension(0), static_cast<long>(K));
+    BOOST_CHECK(moved_ham_par.get_S().get_matrix().data() == S_data);
+    BOOST_CHECK(moved_ham_par.get_h().get_matrix().data() == H_core_data);
+    BOOST_CHECK(moved_ham_par.get_g().get_tensor().data() == g_data);
+    BOOST_CHECK(moved_ham_par.get_C().data() == C_data);
+
+
+    // The Hamiltonian parameters that are constructed from a basis should also be moved without allocations
+    auto mol_ham_par = GQCG::constructMolecularHamiltonianParameters(ao_basis_ptr);
+
+    Eigen::internal::set_is_malloc_allowed(false);
+    GQCG::HamiltonianParameters moved_mol_ham_par (std::move(mol_ham_par));
+    moved_ham_par = std::move(moved_mol_ham_par);
+    Eigen::internal::set_is_malloc_allowed(true);
+
+
+    // Copying is still possible, and allocates
+    GQCG::HamiltonianParameters copied_ham_par (moved_ham_par);
+    BOOST_CHECK(copied_ham_par.get_g().get_tensor().data() != moved_ham_par.get_g().get_tensor().data());
+}
+
+
+BOOST_AUTO_TEST_CASE ( HamiltonianParameters_rotate_JacobiRotationParameters ) {
+
+    // Create random Hamiltonian parameters
+    auto ao_basis_ptr = waterSTO3GBasis();
+    size_t K = ao_basis_ptr->get_number_of_basis_functions();
+
+    auto ham_par1 = randomHamiltonianParameters(ao_basis_ptr);
+    auto ham_par2 = ham_par1;
+
+
+    // Check if a Jacobi rotation gives the same result as a rotation with the Jacobi rotation matrix
+    GQCG::JacobiRotationParameters jacobi_rotation_parameters (5, 2, 0.83);
+    ham_par1.rotate(jacobi_rotation_parameters);
+    ham_par2.rotate(GQCG::jacobiRotationMatrix(jacobi_rotation_parameters, K));
+
+    BOOST_CHECK(ham_par1.get_C().isApprox(ham_par2.get_C(), 1.0e-12));
+    BOOST_CHECK(ham_par1.get_h().get_matrix().isApprox(ham_par2.get_h().get_matrix(), 1.0e-12));
+    BOOST_CHECK(cpputil::linalg::areEqual(ham_par1.get_g().get_matrix_representation(), ham_par2.get_g().get_matrix_representation(), 1.0e-12));
+}
+
+
+BOOST_AUTO_TEST_CASE ( HamiltonianParameters_rotate_sequence_JacobiRotationParameters ) {
+
+    // Create random Hamiltonian parameters
+    auto ao_basis_ptr = waterSTO3GBasis();
+    size_t K = ao_basis_ptr->get_number_of_basis_functions();
+
+    auto ham_par = randomHamiltonianParameters(ao_basis_ptr);
+
+
+    // Check if a short and a long sequence of Jacobi rotations give the same result as rotating with every one of them separately
+    for (size_t number_of_rotations : {static_cast<size_t>(3), 5 * K * K}) {
+        std::vector<GQCG::JacobiRotationParameters> jacobi_rotation_parameters;
+        for (size_t i = 0; i < number_of_rotations; i++) {
+            size_t p = 1 + (3 * i) % (K - 1);
+            size_t q = (5 * i) % p;
+            jacobi_rotation_parameters.emplace_back(p, q, 0.1 * i);
+        }
+
+        auto ham_par1 = ham_par;
+        auto ham_par2 = ham_par;
+
+        ham_par1.rotate(jacobi_rotation_parameters);
+        for (const auto& jacobi_rotation_parameter : jacobi_rotation_parameters) {
+            ham_par2.rotate(jacobi_rotation_parameter);
+        }
+
+        BOOST_CHECK(ham_par1.get_C().isApprox(ham_par2.get_C(), 1.0e-10));
+        BOOST_CHECK(ham_par1.get_h().get_matrix().isApprox(ham_par2.get_h().get_matrix(), 1.0e-10));
+        BOOST_CHECK(cpputil::linalg::areEqual(ham_par1.get_g().get_matrix_representation(), ham_par2.get_g().get_matrix_representation(), 1.0e-10));
+    }
+}
+
+
+BOOST_AUTO_TEST_CASE ( HamiltonianParameters_lazy ) {
+
+    // Create random Hamiltonian parameters
+    auto ao_basis_ptr = waterSTO3GBasis();
+    size_t K = ao_basis_ptr->get_number_of_basis_functions();
+
+    auto ham_par = randomHamiltonianParameters(ao_basis_ptr);
+    auto lazy_ham_par = ham_par;
+    BOOST_CHECK(!ham_par.get_lazy());
+    lazy_ham_par.set_lazy(true);
+    BOOST_CHECK(lazy_ham_par.get_lazy());
+
+
+    // Apply a sequence of transformations and rotations to both the eager and the lazy Hamiltonian parameters
+    Eigen::MatrixXd T = Eigen::MatrixXd::Random(K, K);
+    auto U = GQCG::jacobiRotationMatrix(GQCG::JacobiRotationParameters(4, 1, 0.37), K);
+    GQCG::JacobiRotationParameters jacobi_rotation_parameters (6, 3, 1.21);
+
+    for (auto* hp : {&ham_par, &lazy_ham_par}) {
+        hp->transform(T);
+        hp->rotate(U);
+        hp->rotate(jacobi_rotation_parameters);
+    }
+
+    // Check if S, h and C have been updated immediately, and if g is transformed upon access
+    BOOST_CHECK(lazy_ham_par.get_S().get_matrix().isApprox(ham_par.get_S().get_matrix(), 1.0e-12));
+    BOOST_CHECK(lazy_ham_par.get_h().get_matrix().isApprox(ham_par.get_h().get_matrix(), 1.0e-12));
+    BOOST_CHECK(lazy_ham_par.get_C().isApprox(ham_par.get_C(), 1.0e-12));
+    BOOST_CHECK(cpputil::linalg::areEqual(lazy_ham_par.get_g().get_matrix_representation(), ham_par.get_g().get_matrix_representation(), 1.0e-10));
+
+
+    // Check if turning the lazy mode off applies a pending transformation
+    ham_par.rotate(jacobi_rotation_parameters);
+    lazy_ham_par.rotate(jacobi_rotation_parameters);
+    lazy_ham_par.set_lazy(false);
+    BOOST_CHECK(!lazy_ham_par.get_lazy());
+    BOOST_CHECK(cpputil::linalg::areEqual(lazy_ham_par.get_g().get_matrix_representation(), ham_par.get_g().get_matrix_representation(), 1.0e-10));
+}
+
+
+/**
+ *  @return the energy of the closed-shell determinant in which the given @param occupied_orbitals are doubly occupied,
+ *  for the given @param ham_par
+ */
+double closedShellEnergy(const GQCG::HamiltonianParameters& ham_par, const std::vector<size_t>& occupied_orbitals) {
+
+    const auto& h = ham_par.get_h();
+    const auto& g = ham_par.get_g();
+
+    double energy = ham_par.get_core_energy();
+    for (auto i : occupied_orbitals) {
+        energy += 2 * h.get(i, i);
+        for (auto j : occupied_orbitals) {
+            energy += 2 * g.get(i, i, j, j) - g.get(i, j, j, i);
+        }
+    }
+
+    return energy;
+}
+
+
+BOOST_AUTO_TEST_CASE ( HamiltonianParameters_reduceToActiveSpace ) {
+
+    // Create random Hamiltonian parameters, whose two-electron operator has the permutational symmetry of two-electron integrals
+    auto ao_basis_ptr = waterSTO3GBasis();
+    long K = ao_basis_ptr->get_number_of_basis_functions();
+
+    auto ham_par = randomHamiltonianParameters(ao_basis_ptr);
+    const auto& C = ham_par.get_C();
+
+
+    // Check if wrong orbitals are rejected
+    BOOST_CHECK_THROW(ham_par.reduceToActiveSpace({0, 1}, {}), std::invalid_argument);
+    BOOST_CHECK_THROW(ham_par.reduceToActiveSpace({0, 1}, {1, 2}), std::invalid_argument);
+    BOOST_CHECK_THROW(ham_par.reduceToActiveSpace({0}, {1, static_cast<size_t>(K)}), std::invalid_argument);
+
+
+    // Check if the active-space Hamiltonian parameters give the same closed-shell energies as the full ones
+    std::vector<size_t> inactive_orbitals {0, 3};
+    std::vector<size_t> active_orbitals {5, 1, 2, 6};
+    auto active_ham_par = ham_par.reduceToActiveSpace(inactive_orbitals, active_orbitals);
+
+    BOOST_CHECK_EQUAL(active_ham_par.get_h().get_matrix().rows(), 4);
+    BOOST_CHECK(active_ham_par.get_C().col(0).isApprox(C.col(5)));
+    BOOST_CHECK(active_ham_par.get_S().get_matrix().isApprox(Eigen::MatrixXd::Identity(4, 4)));
+    BOOST_CHECK(std::abs(active_ham_par.get_core_energy() - closedShellEnergy(ham_par, inactive_orbitals)) < 1.0e-10);
+    BOOST_CHECK(std::abs(closedShellEnergy(active_ham_par, {0, 3}) - closedShellEnergy(ham_par, {0, 3, 5, 6})) < 1.0e-10);
+    BOOST_CHECK(std::abs(active_ham_par.get_g().get(1, 2, 3, 0) - ham_par.get_g().get(1, 2, 6, 5)) < 1.0e-12);
+
+
+    // Check if the storage is kept, and if a pending transformation in the lazy mode gives the same result
+    Eigen::MatrixXd U = GQCG::jacobiRotationMatrix(GQCG::JacobiRotationParameters(4, 2, 0.5), K) * GQCG::jacobiRotationMatrix(GQCG::JacobiRotationParameters(6, 0, 1.1), K);
+    auto g_packed = ham_par.get_g();
+    g_packed.pack();
+    GQCG::HamiltonianParameters packed_ham_par (ao_basis_ptr, ham_par.get_S(), ham_par.get_h(), g_packed, C);
+    auto lazy_ham_par = ham_par;
+    lazy_ham_par.set_lazy(true);
+
+    packed_ham_par.rotate(U);
+    lazy_ham_par.rotate(U);
+    auto packed_active_ham_par = packed_ham_par.reduceToActiveSpace(inactive_orbitals, active_orbitals);
+    auto lazy_active_ham_par = lazy_ham_par.reduceToActiveSpace(inactive_orbitals, active_orbitals);
+
+    BOOST_CHECK(packed_active_ham_par.get_g().get_storage() == GQCG::TwoElectronStorage::packed);
+    BOOST_CHECK(std::abs(packed_active_ham_par.get_core_energy() - lazy_active_ham_par.get_core_energy()) < 1.0e-10);
+    BOOST_CHECK(packed_active_ham_par.get_h().get_matrix().isApprox(lazy_active_ham_par.get_h().get_matrix(), 1.0e-10));
+    BOOST_CHECK(cpputil::linalg::areEqual(packed_active_ham_par.get_g().get_matrix_representation(), lazy_active_ham_par.get_g().get_matrix_representation(), 1.0e-10));
+}
@@ -0,0 +1,174 @@
+#define BOOST_TEST_MODULE "IntegralCache"
+
+
+#include "IntegralCache.hpp"
+
+#include "LibintCommunicator.hpp"
+
+#include <cpputil.hpp>
+
+#include <cstdio>
+#include <fstream>
+#include <thread>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/test/included/unit_test.hpp>  // include this to get main(), otherwise the compiler will complain
+
+
+
+BOOST_AUTO_TEST_CASE ( fingerprint ) {
+
+    GQCG::Molecule water ("../tests/data/h2o.xyz");
+    GQCG::Molecule h2 ("../tests/data/h2_szabo.xyz");
+
+    GQCG::AOBasis water_sto3g (water, "STO-3G");
+    GQCG::AOBasis water_sto3g_copy (water, "STO-3G");
+    GQCG::AOBasis water_sto3g_lowercase (water, "sto-3g");
+    GQCG::AOBasis water_631g (water, "6-31G");
+    GQCG::AOBasis h2_sto3g (h2, "STO-3G");
+
+    BOOST_CHECK_EQUAL(GQCG::IntegralCache::fingerprint(water_sto3g), GQCG::IntegralCache::fingerprint(water_sto3g_copy));
+    BOOST_CHECK_EQUAL(GQCG::IntegralCache::fingerprint(water_sto3g), GQCG::IntegralCache::fingerprint(water_sto3g_lowercase));  // the same basis, under another name
+    BOOST_CHECK(GQCG::IntegralCache::fingerprint(water_sto3g) != GQCG::IntegralCache::fingerprint(water_631g));
+    BOOST_CHECK(GQCG::IntegralCache::fingerprint(water_sto3g) != GQCG::IntegralCache::fingerprint(h2_sto3g));
+}
+
+
+BOOST_AUTO_TEST_CASE ( cached_two_electron_integrals ) {
+
+    GQCG::Molecule water ("../tests/data/h2o.xyz");
+    GQCG::AOBasis basis (water, "STO-3G");
+
+    GQCG::IntegralCache cache (".");
+    std::remove(cache.filename(basis).c_str());
+    BOOST_CHECK(!cache.contains(basis));
+
+
+    // The first request calculates the integrals and stores them, the next ones read them from the cache
+    auto g_ref = GQCG::LibintCommunicator::get().calculateTwoElectronIntegrals(libint2::Operator::coulomb, basis);
+
+    auto g_calculated = cache.calculateTwoElectronIntegrals(basis);
+    BOOST_CHECK(cache.contains(basis));
+
+    auto g_cached = cache.calculateTwoElectronIntegrals(basis);
+    auto g_cached_packed = cache.calculateTwoElectronIntegrals(basis, GQCG::TwoElectronStorage::packed);
+
+    BOOST_CHECK(g_cached_packed.get_storage() == GQCG::TwoElectronStorage::packed);
+    BOOST_CHECK(cpputil::linalg::areEqual(g_calculated.get_matrix_representation(), g_ref.get_matrix_representation(), 1.0e-15));
+    BOOST_CHECK(cpputil::linalg::areEqual(g_cached.get_matrix_representation(), g_ref.get_matrix_representation(), 1.0e-15));
+    BOOST_CHECK(cpputil::linalg::areEqual(g_cached_packed.get_matrix_representation(), g_ref.get_matrix_representation(), 1.0e-15));
+
+    std::remove(cache.filename(basis).c_str());
+}
+
+
+BOOST_AUTO_TEST_CASE ( mapped_two_electron_integrals ) {
+
+    GQCG::Molecule water ("../tests/data/h2o.xyz");
+    GQCG::AOBasis basis (water, "STO-3G");
+
+    GQCG::IntegralCache cache (".");
+    std::remove(cache.filename(basis).c_str());
+
+
+    // The first mapping calculates and stores the integrals, the next ones map the same cache file
+    auto g_ref = GQCG::LibintCommunicator::get().calculateTwoElectronIntegrals(libint2::Operator::coulomb, basis, GQCG::TwoElectronStorage::packed);
+
+    auto mapped_g = cache.map(basis);
+    BOOST_CHECK(cache.contains(basis));
+
+    auto mapped_g_again = cache.map(basis);
+    auto moved_mapped_g = std::move(mapped_g_again);  // moving a mapping doesn't unmap it
+
+    size_t K = basis.get_number_of_basis_functions();
+    BOOST_CHECK_EQUAL(mapped_g.get_dim(), K);
+    BOOST_CHECK(mapped_g.get_packed_elements() == g_ref.get_packed_elements());
+    BOOST_CHECK(moved_mapped_g.get_packed_elements() == g_ref.get_packed_elements());
+
+    for (size_t p = 0; p < K; p++) {
+        for (size_t q = 0; q < K; q++) {
+            for (size_t r = 0; r < K; r++) {
+                for (size_t s = 0; s < K; s++) {
+                    BOOST_CHECK_EQUAL(mapped_g(p, q, r, s), g_ref.get(p, q, r, s));
+                }
+            }
+        }
+    }
+
+
+    // The mapping stays valid after the cache file is removed
+    std::remove(cache.filename(basis).c_str());
+    BOOST_CHECK(mapped_g.get_packed_elements() == g_ref.get_packed_elements());
+}
+
+
+BOOST_AUTO_TEST_CASE ( unwritable_cache ) {
+
+    GQCG::Molecule water ("../tests/data/h2o.xyz");
+    GQCG::AOBasis basis (water, "STO-3G");
+
+    GQCG::IntegralCache cache ("./this_directory_does_not_exist");
+
+
+    // The integrals are still calculated if they can't be stored, but they can't be mapped
+    auto g_ref = GQCG::LibintCommunicator::get().calculateTwoElectronIntegrals(libint2::Operator::coulomb, basis);
+    auto g = cache.calculateTwoElectronIntegrals(basis);
+
+    BOOST_CHECK(!cache.contains(basis));
+    BOOST_CHECK(cpputil::linalg::areEqual(g.get_matrix_representation(), g_ref.get_matrix_representation(), 1.0e-15));
+    BOOST_CHECK_THROW(cache.map(basis), std::runtime_error);
+}
+
+
+BOOST_AUTO_TEST_CASE ( concurrent_stores ) {
+
+    GQCG::Molecule water ("../tests/data/h2o.xyz");
+    GQCG::AOBasis basis (water, "STO-3G");
+
+    GQCG::IntegralCache cache (".");
+    std::remove(cache.filename(basis).c_str());
+
+
+    // Two threads that miss the cache at the same time both store the integrals, through their own temporary file
+    auto g_ref = GQCG::LibintCommunicator::get().calculateTwoElectronIntegrals(libint2::Operator::coulomb, basis);
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < 2; i++) {
+        threads.emplace_back([&cache, &basis] () { cache.calculateTwoElectronIntegrals(basis, GQCG::TwoElectronStorage::packed); });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    BOOST_CHECK(cache.contains(basis));
+    BOOST_CHECK(cpputil::linalg::areEqual(cache.calculateTwoElectronIntegrals(basis).get_matrix_representation(), g_ref.get_matrix_representation(), 1.0e-15));
+
+    std::remove(cache.filename(basis).c_str());
+}
+
+
+BOOST_AUTO_TEST_CASE ( invalid_cache_file ) {
+
+    GQCG::Molecule water ("../tests/data/h2o.xyz");
+    GQCG::AOBasis basis (water, "STO-3G");
+
+    GQCG::IntegralCache cache (".");
+
+
+    // A truncated or corrupt cache file is not used, but recalculated
+    std::ofstream corrupt_file (cache.filename(basis), std::ios::binary);
+    corrupt_file << "not a cache file";
+    corrupt_file.close();
+    BOOST_CHECK(!cache.contains(basis));
+
+    auto g_ref = GQCG::LibintCommunicator::get().calculateTwoElectronIntegrals(libint2::Operator::coulomb, basis);
+    auto g = cache.calculateTwoElectronIntegrals(basis);
+    BOOST_CHECK(cpputil::linalg::areEqual(g.get_matrix_representation(), g_ref.get_matrix_representation(), 1.0e-15));
+    BOOST_CHECK(cache.contains(basis));
+
+    std::remove(cache.filename(basis).c_str());
+
+
+    // The factorized storage can't be requested from the cache
+    BOOST_CHECK_THROW(cache.calculateTwoElectronIntegrals(basis, GQCG::TwoElectronStorage::factorized), std::invalid_argument);
+}
@@ -5,6 +5,9 @@
 
 #include <cpputil.hpp>
 
+#include <algorithm>
+#include <thread>
+
 #include <boost/test/unit_test.hpp>
 #include <boost/test/included/unit_test.hpp>  // include this to get main(), otherwise the compiler will complain
 
@@ -138,3 +141,743 @@ BOOST_AUTO_TEST_CASE( HORTON_integrals_h2o_sto3g ) {
 }
 
 
+
+
+BOOST_AUTO_TEST_CASE ( two_electron_integrals_permutational_symmetry ) {
+
+    // Set up a basis
+    GQCG::Molecule water ("../tests/data/h2o.xyz");
+    GQCG::AOBasis basis (water, "STO-3G");
+    auto nbf = static_cast<long>(basis.get_number_of_basis_functions());
+
+
+    // Only the canonical shell quartets are calculated, so check if the integrals are scattered to all 8 symmetry-equivalent positions
+    auto g = GQCG::LibintCommunicator::get().calculateTwoElectronIntegrals(libint2::Operator::coulomb, basis).get_matrix_representation();
+
+    for (long p = 0; p < nbf; p++) {
+        for (long q = 0; q < nbf; q++) {
+            for (long r = 0; r < nbf; r++) {
+                for (long s = 0; s < nbf; s++) {
+                    BOOST_CHECK(std::abs(g(p,q,r,s) - g(q,p,r,s)) < 1.0e-12);
+                    BOOST_CHECK(std::abs(g(p,q,r,s) - g(p,q,s,r)) < 1.0e-12);
+                    BOOST_CHECK(std::abs(g(p,q,r,s) - g(r,s,p,q)) < 1.0e-12);
+                }
+            }
+        }
+    }
+}
+
+
+BOOST_AUTO_TEST_CASE ( two_electron_integrals_operator_type ) {
+
+    // Set up a basis
+    GQCG::Molecule water ("../tests/data/h2o.xyz");
+    GQCG::AOBasis basis (water, "STO-3G");
+    auto nbf = static_cast<long>(basis.get_number_of_basis_functions());
+
+
+    // The four-center overlap integrals (pq|delta|rs) are invariant under any permutation of the basis functions, while
+    // the Coulomb integrals are not: check that the requested operator is actually calculated
+    auto& libint_communicator = GQCG::LibintCommunicator::get();
+    libint_communicator.set_schwarz_threshold(1.0e-10);  // the Schwarz bounds should not be used for other operators
+    auto g_delta = libint_communicator.calculateTwoElectronIntegrals(libint2::Operator::delta, basis).get_matrix_representation();
+    libint_communicator.set_schwarz_threshold(0.0);
+    auto g_coulomb = libint_communicator.calculateTwoElectronIntegrals(libint2::Operator::coulomb, basis).get_matrix_representation();
+
+    bool coulomb_is_invariant = true;
+    for (long p = 0; p < nbf; p++) {
+        for (long q = 0; q < nbf; q++) {
+            for (long r = 0; r < nbf; r++) {
+                for (long s = 0; s < nbf; s++) {
+                    BOOST_CHECK(std::abs(g_delta(p,q,r,s) - g_delta(p,r,q,s)) < 1.0e-12);
+                    coulomb_is_invariant = coulomb_is_invariant && (std::abs(g_coulomb(p,q,r,s) - g_coulomb(p,r,q,s)) < 1.0e-12);
+                }
+            }
+        }
+    }
+    BOOST_CHECK(!coulomb_is_invariant);
+}
+
+
+BOOST_AUTO_TEST_CASE ( multithreaded_integrals ) {
+
+    // Set up a basis
+    GQCG::Molecule water ("../tests/data/h2o.xyz");
+    GQCG::AOBasis basis (water, "STO-3G");
+
+
+    // Calculate the integrals serially
+    auto& libint_communicator = GQCG::LibintCommunicator::get();
+    BOOST_REQUIRE_THROW(libint_communicator.set_number_of_threads(0), std::invalid_argument);
+    libint_communicator.set_number_of_threads(1);
+
+    auto V_serial = libint_communicator.calculateOneElectronIntegrals(libint2::Operator::nuclear, basis);
+    auto g_serial = libint_communicator.calculateTwoElectronIntegrals(libint2::Operator::coulomb, basis);
+
+
+    // Calculate the integrals in parallel and check if they are bitwise identical to the serial ones
+    libint_communicator.set_number_of_threads(4);
+
+    auto V_parallel = libint_communicator.calculateOneElectronIntegrals(libint2::Operator::nuclear, basis);
+    auto g_parallel = libint_communicator.calculateTwoElectronIntegrals(libint2::Operator::coulomb, basis);
+
+    libint_communicator.set_number_of_threads(1);
+
+
+    BOOST_CHECK(V_serial.get_matrix_representation() == V_parallel.get_matrix_representation());
+    BOOST_CHECK(cpputil::linalg::areEqual(g_serial.get_matrix_representation(), g_parallel.get_matrix_representation(), 0.0));
+}
+
+
+BOOST_AUTO_TEST_CASE ( schwarz_screening ) {
+
+    // Set up a basis
+    GQCG::Molecule water ("../tests/data/h2o.xyz");
+    GQCG::AOBasis basis (water, "STO-3G");  // 5 shells, so 15 shell pairs and 120 canonical shell quartets
+
+    auto& libint_communicator = GQCG::LibintCommunicator::get();
+    BOOST_REQUIRE_THROW(libint_communicator.set_schwarz_threshold(-1.0), std::invalid_argument);
+
+
+    // Without screening, no shell quartets should be skipped
+    auto g_ref = libint_communicator.calculateTwoElectronIntegrals(libint2::Operator::coulomb, basis);
+    BOOST_CHECK_EQUAL(libint_communicator.get_number_of_screened_quartets(), 0);
+
+
+    // With a small threshold, the skipped integrals should be smaller than the threshold
+    libint_communicator.set_schwarz_threshold(1.0e-03);
+    auto g_screened = libint_communicator.calculateTwoElectronIntegrals(libint2::Operator::coulomb, basis);
+    BOOST_CHECK(cpputil::linalg::areEqual(g_screened.get_matrix_representation(), g_ref.get_matrix_representation(), 1.0e-03));
+
+
+    // With a huge threshold, every shell quartet should be skipped
+    libint_communicator.set_schwarz_threshold(1.0e+06);
+    auto g_zero = libint_communicator.calculateTwoElectronIntegrals(libint2::Operator::coulomb, basis);
+    BOOST_CHECK_EQUAL(libint_communicator.get_number_of_screened_quartets(), 120);
+
+    Eigen::Tensor<double, 4> zero (7, 7, 7, 7);
+    zero.setZero();
+    BOOST_CHECK(cpputil::linalg::areEqual(g_zero.get_matrix_representation(), zero, 1.0e-12));
+
+    libint_communicator.set_schwarz_threshold(0.0);
+}
+
+
+BOOST_AUTO_TEST_CASE ( packed_two_electron_integrals ) {
+
+    // Set up a basis
+    GQCG::Molecule water ("../tests/data/h2o.xyz");
+    GQCG::AOBasis basis (water, "STO-3G");
+
+
+    // Check if the packed integrals are the same as the dense ones
+    auto g_dense = GQCG::LibintCommunicator::get().calculateTwoElectronIntegrals(libint2::Operator::coulomb, basis);
+    auto g_packed = GQCG::LibintCommunicator::get().calculateTwoElectronIntegrals(libint2::Operator::coulomb, basis, GQCG::TwoElectronStorage::packed);
+
+    BOOST_CHECK(g_packed.get_storage() == GQCG::TwoElectronStorage::packed);
+    BOOST_CHECK(cpputil::linalg::areEqual(g_packed.get_matrix_representation(), g_dense.get_matrix_representation(), 1.0e-12));
+}
+
+
+BOOST_AUTO_TEST_CASE ( recalculate_two_electron_integrals ) {
+
+    // Set up two bases with a different number of basis functions
+    GQCG::Molecule water ("../tests/data/h2o.xyz");
+    GQCG::AOBasis basis (water, "STO-3G");
+    GQCG::AOBasis larger_basis (water, "6-31G");
+
+    auto& libint_communicator = GQCG::LibintCommunicator::get();
+    auto g_dense = libint_communicator.calculateTwoElectronIntegrals(libint2::Operator::coulomb, basis);
+    auto g_larger = libint_communicator.calculateTwoElectronIntegrals(libint2::Operator::coulomb, larger_basis);
+
+
+    // Check if recalculating the integrals in place gives the same integrals, also if the operator has to be resized
+    for (const auto storage : {GQCG::TwoElectronStorage::dense, GQCG::TwoElectronStorage::packed}) {
+        auto g = libint_communicator.calculateTwoElectronIntegrals(libint2::Operator::coulomb, larger_basis, storage);
+
+        libint_communicator.recalculateTwoElectronIntegrals(libint2::Operator::coulomb, basis, g);
+        BOOST_CHECK(g.get_storage() == storage);
+        BOOST_CHECK(cpputil::linalg::areEqual(g.get_matrix_representation(), g_dense.get_matrix_representation(), 1.0e-12));
+
+        libint_communicator.recalculateTwoElectronIntegrals(libint2::Operator::coulomb, larger_basis, g);
+        BOOST_CHECK(cpputil::linalg::areEqual(g.get_matrix_representation(), g_larger.get_matrix_representation(), 1.0e-12));
+    }
+
+
+    // Check if the mixed storage can't be recalculated in place
+    auto g_mixed = libint_communicator.calculateTwoElectronIntegrals(libint2::Operator::coulomb, basis, GQCG::TwoElectronStorage::mixed);
+    BOOST_CHECK_THROW(libint_communicator.recalculateTwoElectronIntegrals(libint2::Operator::coulomb, basis, g_mixed), std::invalid_argument);
+}
+
+
+BOOST_AUTO_TEST_CASE ( mixed_two_electron_integrals ) {
+
+    // Set up a basis
+    GQCG::Molecule water ("../tests/data/h2o.xyz");
+    GQCG::AOBasis basis (water, "STO-3G");
+
+
+    // Check if the mixed-precision integrals are within the default error bound of the dense ones
+    auto g_dense = GQCG::LibintCommunicator::get().calculateTwoElectronIntegrals(libint2::Operator::coulomb, basis);
+    auto g_mixed = GQCG::LibintCommunicator::get().calculateTwoElectronIntegrals(libint2::Operator::coulomb, basis, GQCG::TwoElectronStorage::mixed);
+
+    BOOST_CHECK(g_mixed.get_storage() == GQCG::TwoElectronStorage::mixed);
+    BOOST_CHECK_EQUAL(g_mixed.get_error_bound(), GQCG::TwoElectronOperator::default_error_bound);
+    BOOST_CHECK(cpputil::linalg::areEqual(g_mixed.get_matrix_representation(), g_dense.get_matrix_representation(), GQCG::TwoElectronOperator::default_error_bound));
+}
+
+
+BOOST_AUTO_TEST_CASE ( Cholesky_decomposed_two_electron_integrals ) {
+
+    // Set up a basis
+    GQCG::Molecule water ("../tests/data/h2o.xyz");
+    GQCG::AOBasis basis (water, "STO-3G");
+    auto nbf = basis.get_number_of_basis_functions();
+
+    auto g_dense = GQCG::LibintCommunicator::get().calculateTwoElectronIntegrals(libint2::Operator::coulomb, basis);
+    BOOST_CHECK_THROW(GQCG::LibintCommunicator::get().calculateTwoElectronIntegrals(libint2::Operator::coulomb, basis, GQCG::TwoElectronStorage::factorized), std::invalid_argument);
+
+
+    // Check if the Cholesky decomposition reproduces the integrals within the tolerance, with fewer than K^2 vectors
+    for (double tolerance : {1.0e-04, 1.0e-08}) {
+        auto g_cholesky = GQCG::LibintCommunicator::get().calculateCholeskyDecomposedTwoElectronIntegrals(libint2::Operator::coulomb, basis, tolerance);
+
+        BOOST_CHECK(g_cholesky.get_storage() == GQCG::TwoElectronStorage::factorized);
+        BOOST_CHECK(g_cholesky.get_number_of_factors() < nbf * nbf);
+        BOOST_CHECK(cpputil::linalg::areEqual(g_cholesky.get_matrix_representation(), g_dense.get_matrix_representation(), tolerance));
+    }
+
+
+    // An empty basis gives an empty decomposition
+    GQCG::Molecule no_atoms (std::vector<GQCG::Atom>{});
+    GQCG::AOBasis empty_basis (no_atoms, "STO-3G");
+    auto g_empty = GQCG::LibintCommunicator::get().calculateCholeskyDecomposedTwoElectronIntegrals(libint2::Operator::coulomb, empty_basis, 1.0e-08);
+
+    BOOST_CHECK_EQUAL(g_empty.get_number_of_factors(), 0);
+    BOOST_CHECK_EQUAL(g_empty.get_matrix_representation().size(), 0);
+}
+
+
+BOOST_AUTO_TEST_CASE ( density_fitted_integrals ) {
+
+    // Set up a basis and a fitting basis
+    GQCG::Molecule water ("../tests/data/h2o.xyz");
+    GQCG::AOBasis basis (water, "STO-3G");
+    GQCG::AOBasis auxiliary_basis (water, "cc-pVDZ-RI");
+    auto nbf = basis.get_number_of_basis_functions();
+
+    auto g_dense = GQCG::LibintCommunicator::get().calculateTwoElectronIntegrals(libint2::Operator::coulomb, basis);
+    auto g_fitted = GQCG::LibintCommunicator::get().calculateDensityFittedIntegrals(basis, auxiliary_basis);
+
+    BOOST_CHECK(g_fitted.get_storage() == GQCG::TwoElectronStorage::factorized);
+    BOOST_CHECK_EQUAL(g_fitted.get_number_of_factors(), auxiliary_basis.get_number_of_basis_functions());
+
+
+    // The Coulomb-metric fitting error is positive semi-definite, so the fitted diagonal elements can't be larger than the exact ones
+    for (size_t p = 0; p < nbf; p++) {
+        for (size_t q = 0; q < nbf; q++) {
+            BOOST_CHECK(g_fitted.get(p, q, p, q) <= g_dense.get(p, q, p, q) + 1.0e-10);
+            BOOST_CHECK(std::abs(g_fitted.get(p, q, p, q) - g_fitted.get(q, p, p, q)) < 1.0e-12);
+        }
+    }
+
+
+    // Assemble the fitted integrals (pq|rs) = sum_PQ (pq|P) (P|Q)^(-1) (Q|rs) explicitly from libint's two- and three-center integrals
+    auto libint_atoms = GQCG::LibintCommunicator::get().interface(basis.get_atoms());
+    libint2::BasisSet obs ("STO-3G", libint_atoms);
+    libint2::BasisSet dfbs ("cc-pVDZ-RI", libint_atoms);
+    auto naux = static_cast<size_t>(dfbs.nbf());
+    auto max_nprim = std::max(obs.max_nprim(), dfbs.max_nprim());
+    auto max_l = static_cast<int>(std::max(obs.max_l(), dfbs.max_l()));
+    const auto& unit_shell = libint2::Shell::unit();
+    const auto shell2bf = obs.shell2bf();
+    const auto shell2bf_aux = dfbs.shell2bf();
+
+    Eigen::MatrixXd metric = Eigen::MatrixXd::Zero(naux, naux);  // (P|Q)
+    libint2::Engine two_center_engine (libint2::Operator::coulomb, max_nprim, max_l);
+    two_center_engine.set(libint2::BraKet::xs_xs);
+    for (size_t sh1 = 0; sh1 < dfbs.size(); sh1++) {
+        for (size_t sh2 = 0; sh2 < dfbs.size(); sh2++) {
+            two_center_engine.compute(dfbs[sh1], unit_shell, dfbs[sh2], unit_shell);
+            auto integrals = two_center_engine.results()[0];
+            if (integrals == nullptr) {
+                continue;
+            }
+
+            for (size_t f1 = 0; f1 < dfbs[sh1].size(); f1++) {
+                for (size_t f2 = 0; f2 < dfbs[sh2].size(); f2++) {
+                    metric(shell2bf_aux[sh1] + f1, shell2bf_aux[sh2] + f2) = integrals[f2 + dfbs[sh2].size() * f1];
+                }
+            }
+        }
+    }
+
+    Eigen::MatrixXd three_center_integrals = Eigen::MatrixXd::Zero(nbf * nbf, naux);  // (P|pq), with row index p + K q
+    libint2::Engine three_center_engine (libint2::Operator::coulomb, max_nprim, max_l);
+    three_center_engine.set(libint2::BraKet::xs_xx);
+    for (size_t sh_aux = 0; sh_aux < dfbs.size(); sh_aux++) {
+        for (size_t sh1 = 0; sh1 < obs.size(); sh1++) {
+            for (size_t sh2 = 0; sh2 < obs.size(); sh2++) {
+                three_center_engine.compute(dfbs[sh_aux], unit_shell, obs[sh1], obs[sh2]);
+                auto integrals = three_center_engine.results()[0];
+                if (integrals == nullptr) {
+                    continue;
+                }
+
+                for (size_t fP = 0; fP < dfbs[sh_aux].size(); fP++) {
+                    for (size_t f1 = 0; f1 < obs[sh1].size(); f1++) {
+                        for (size_t f2 = 0; f2 < obs[sh2].size(); f2++) {
+                            auto p = shell2bf[sh1] + f1;
+                            auto q = shell2bf[sh2] + f2;
+                            three_center_integrals(p + nbf * q, shell2bf_aux[sh_aux] + fP) = integrals[f2 + obs[sh2].size() * (f1 + obs[sh1].size() * fP)];
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    Eigen::MatrixXd ref_fitted_integrals = three_center_integrals * metric.ldlt().solve(three_center_integrals.transpose());
+
+    for (size_t p = 0; p < nbf; p++) {
+        for (size_t q = 0; q < nbf; q++) {
+            for (size_t r = 0; r < nbf; r++) {
+                for (size_t s = 0; s < nbf; s++) {
+                    BOOST_CHECK(std::abs(g_fitted.get(p, q, r, s) - ref_fitted_integrals(p + nbf * q, r + nbf * s)) < 1.0e-10);
+                }
+            }
+        }
+    }
+}
+
+
+BOOST_AUTO_TEST_CASE ( visit_two_electron_integrals ) {
+
+    // Build the Coulomb matrix J_pq = sum_rs (pq|rs) D_rs on the fly, without storing the two-electron integrals
+    GQCG::Molecule water ("../tests/data/h2o.xyz");
+    GQCG::AOBasis basis (water, "STO-3G");
+    auto nbf = basis.get_number_of_basis_functions();
+
+    Eigen::MatrixXd D = Eigen::MatrixXd::Random(nbf, nbf);
+    D = D + D.transpose().eval();
+
+    GQCG::LibintCommunicator::get().set_number_of_threads(2);
+    std::vector<Eigen::MatrixXd> J_per_thread (2, Eigen::MatrixXd::Zero(nbf, nbf));  // every thread has its own accumulator
+    GQCG::LibintCommunicator::get().visitTwoElectronIntegrals(libint2::Operator::coulomb, basis, [&] (const GQCG::ShellQuartetBlock& block, size_t thread) {
+        auto& J_thread = J_per_thread[thread];
+
+        for (size_t f1 = 0; f1 < block.nbf[0]; f1++) {
+            for (size_t f2 = 0; f2 < block.nbf[1]; f2++) {
+                for (size_t f3 = 0; f3 < block.nbf[2]; f3++) {
+                    for (size_t f4 = 0; f4 < block.nbf[3]; f4++) {
+                        auto p = block.first_bf[0] + f1;
+                        auto q = block.first_bf[1] + f2;
+                        auto r = block.first_bf[2] + f3;
+                        auto s = block.first_bf[3] + f4;
+
+                        double value = block(f1, f2, f3, f4) * block.degeneracy();
+                        J_thread(p, q) += D(r, s) * value;
+                        J_thread(r, s) += D(p, q) * value;
+                    }
+                }
+            }
+        }
+    });
+    GQCG::LibintCommunicator::get().set_number_of_threads(1);
+
+    Eigen::MatrixXd J_visited = J_per_thread[0] + J_per_thread[1];
+    J_visited = 0.25 * (J_visited + J_visited.transpose().eval());  // symmetrize
+
+
+    // Compare with the contraction of the full tensor
+    auto g = GQCG::LibintCommunicator::get().calculateTwoElectronIntegrals(libint2::Operator::coulomb, basis).get_matrix_representation();
+    Eigen::MatrixXd J_ref = Eigen::MatrixXd::Zero(nbf, nbf);
+    for (size_t p = 0; p < nbf; p++) {
+        for (size_t q = 0; q < nbf; q++) {
+            for (size_t r = 0; r < nbf; r++) {
+                for (size_t s = 0; s < nbf; s++) {
+                    J_ref(p, q) += g(p, q, r, s) * D(r, s);
+                }
+            }
+        }
+    }
+
+    BOOST_CHECK(J_visited.isApprox(J_ref, 1.0e-12));
+}
+
+
+BOOST_AUTO_TEST_CASE ( coulomb_and_exchange_matrices ) {
+
+    GQCG::Molecule water ("../tests/data/h2o.xyz");
+    GQCG::AOBasis basis (water, "STO-3G");
+    auto nbf = basis.get_number_of_basis_functions();
+
+    std::vector<Eigen::MatrixXd> densities;
+    for (size_t i = 0; i < 2; i++) {
+        Eigen::MatrixXd D = Eigen::MatrixXd::Random(nbf, nbf);
+        densities.emplace_back(D + D.transpose());
+    }
+
+
+    // Calculate the reference Coulomb and exchange matrices from the full tensor
+    auto g = GQCG::LibintCommunicator::get().calculateTwoElectronIntegrals(libint2::Operator::coulomb, basis).get_matrix_representation();
+
+    GQCG::LibintCommunicator::get().set_number_of_threads(2);
+    auto JK = GQCG::LibintCommunicator::get().calculateCoulombAndExchangeMatrices(densities, basis);
+    GQCG::LibintCommunicator::get().set_number_of_threads(1);
+
+    for (size_t i = 0; i < 2; i++) {
+        const auto& D = densities[i];
+
+        Eigen::MatrixXd J_ref = Eigen::MatrixXd::Zero(nbf, nbf);
+        Eigen::MatrixXd K_ref = Eigen::MatrixXd::Zero(nbf, nbf);
+        for (size_t p = 0; p < nbf; p++) {
+            for (size_t q = 0; q < nbf; q++) {
+                for (size_t r = 0; r < nbf; r++) {
+                    for (size_t s = 0; s < nbf; s++) {
+                        J_ref(p, q) += g(p, q, r, s) * D(r, s);
+                        K_ref(p, r) += g(p, q, r, s) * D(q, s);
+                    }
+                }
+            }
+        }
+
+        BOOST_CHECK(JK.first[i].get_matrix_representation().isApprox(J_ref, 1.0e-12));
+        BOOST_CHECK(JK.second[i].get_matrix_representation().isApprox(K_ref, 1.0e-12));
+    }
+}
+
+
+BOOST_AUTO_TEST_CASE ( coulomb_and_exchange_matrices_density_screening ) {
+
+    GQCG::Molecule water ("../tests/data/h2o.xyz");
+    GQCG::AOBasis basis (water, "STO-3G");
+    auto nbf = basis.get_number_of_basis_functions();
+
+    // A density that only lives on the first basis function makes most of the shell quartets negligible
+    Eigen::MatrixXd D = Eigen::MatrixXd::Zero(nbf, nbf);
+    D(0, 0) = 1.0;
+
+    // Calculate the reference Coulomb and exchange matrices from the full tensor
+    auto g = GQCG::LibintCommunicator::get().calculateTwoElectronIntegrals(libint2::Operator::coulomb, basis).get_matrix_representation();
+
+    Eigen::MatrixXd J_ref = Eigen::MatrixXd::Zero(nbf, nbf);
+    Eigen::MatrixXd K_ref = Eigen::MatrixXd::Zero(nbf, nbf);
+    for (size_t p = 0; p < nbf; p++) {
+        for (size_t q = 0; q < nbf; q++) {
+            J_ref(p, q) = g(p, q, 0, 0);
+            K_ref(p, q) = g(p, 0, q, 0);
+        }
+    }
+
+
+    // Even with the default settings (i.e. without a Schwarz threshold), the shell quartets are screened with the target accuracy
+    auto JK_default = GQCG::LibintCommunicator::get().calculateCoulombAndExchangeMatrices({D}, basis);
+    auto number_of_screened_quartets_default = GQCG::LibintCommunicator::get().get_number_of_screened_quartets();
+    BOOST_CHECK(number_of_screened_quartets_default > 0);
+
+    BOOST_CHECK(JK_default.first[0].get_matrix_representation().isApprox(J_ref, 1.0e-12));
+    BOOST_CHECK(JK_default.second[0].get_matrix_representation().isApprox(K_ref, 1.0e-12));
+
+
+    // A larger threshold screens more shell quartets
+    GQCG::LibintCommunicator::get().set_schwarz_threshold(1.0e-10);
+    auto JK = GQCG::LibintCommunicator::get().calculateCoulombAndExchangeMatrices({D}, basis);
+    BOOST_CHECK(GQCG::LibintCommunicator::get().get_number_of_screened_quartets() >= number_of_screened_quartets_default);
+    GQCG::LibintCommunicator::get().set_schwarz_threshold(0.0);
+
+    BOOST_CHECK(JK.first[0].get_matrix_representation().isApprox(J_ref, 1.0e-08));
+    BOOST_CHECK(JK.second[0].get_matrix_representation().isApprox(K_ref, 1.0e-08));
+
+    BOOST_CHECK_THROW(GQCG::LibintCommunicator::get().calculateCoulombAndExchangeMatrices({Eigen::MatrixXd::Zero(nbf + 1, nbf + 1)}, basis), std::invalid_argument);
+}
+
+
+BOOST_AUTO_TEST_CASE ( batched_one_electron_integrals ) {
+
+    GQCG::Molecule water ("../tests/data/h2o.xyz");
+    GQCG::AOBasis basis (water, "STO-3G");
+
+    auto S = GQCG::LibintCommunicator::get().calculateOneElectronIntegrals(libint2::Operator::overlap, basis);
+    auto T = GQCG::LibintCommunicator::get().calculateOneElectronIntegrals(libint2::Operator::kinetic, basis);
+    auto V = GQCG::LibintCommunicator::get().calculateOneElectronIntegrals(libint2::Operator::nuclear, basis);
+
+
+    // Calculate the integrals together, including the (overlap and) dipole integrals
+    auto operators = GQCG::LibintCommunicator::get().calculateOneElectronIntegrals({libint2::Operator::overlap, libint2::Operator::kinetic, libint2::Operator::nuclear, libint2::Operator::emultipole1}, basis);
+    BOOST_REQUIRE_EQUAL(operators.size(), 7);
+
+    BOOST_CHECK(operators[0].get_matrix_representation().isApprox(S.get_matrix_representation(), 1.0e-12));
+    BOOST_CHECK(operators[1].get_matrix_representation().isApprox(T.get_matrix_representation(), 1.0e-12));
+    BOOST_CHECK(operators[2].get_matrix_representation().isApprox(V.get_matrix_representation(), 1.0e-12));
+    BOOST_CHECK(operators[3].get_matrix_representation().isApprox(S.get_matrix_representation(), 1.0e-12));  // the first component of emultipole1 is the overlap
+
+    for (size_t i = 4; i < 7; i++) {  // the dipole integrals are symmetric
+        Eigen::MatrixXd dipole = operators[i].get_matrix_representation();
+        BOOST_CHECK(dipole.isApprox(dipole.transpose(), 1.0e-12));
+    }
+}
+
+
+BOOST_AUTO_TEST_CASE ( concurrent_integral_calculations ) {
+
+    GQCG::Molecule water ("../tests/data/h2o.xyz");
+    GQCG::AOBasis basis (water, "STO-3G");
+
+    auto V_ref = GQCG::LibintCommunicator::get().calculateOneElectronIntegrals(libint2::Operator::nuclear, basis).get_matrix_representation();
+    auto g_ref = GQCG::LibintCommunicator::get().calculateTwoElectronIntegrals(libint2::Operator::coulomb, basis).get_matrix_representation();
+    BOOST_CHECK(GQCG::LibintCommunicator::get().get_number_of_idle_engines() > 0);  // the engines have been returned to the pool
+
+
+    // Calculate the integrals concurrently from different threads, which share the engine pool
+    std::vector<Eigen::MatrixXd> V (4);
+    std::vector<Eigen::Tensor<double, 4>> g (4);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < 4; i++) {
+        threads.emplace_back([&basis, &V, &g, i] () {
+            V[i] = GQCG::LibintCommunicator::get().calculateOneElectronIntegrals(libint2::Operator::nuclear, basis).get_matrix_representation();
+            g[i] = GQCG::LibintCommunicator::get().calculateTwoElectronIntegrals(libint2::Operator::coulomb, basis).get_matrix_representation();
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    for (size_t i = 0; i < 4; i++) {
+        BOOST_CHECK(V[i].isApprox(V_ref, 1.0e-12));
+        BOOST_CHECK(cpputil::linalg::areEqual(g[i], g_ref, 1.0e-12));
+    }
+}
+
+
+BOOST_AUTO_TEST_CASE ( shell_order_independence ) {
+
+    // Water in 6-31G** has s, p and d shells with different numbers of primitives, which are visited in a sorted order
+    GQCG::Molecule water ("../tests/data/h2o.xyz");
+    GQCG::AOBasis basis (water, "6-31G**");
+    auto nbf = basis.get_number_of_basis_functions();
+
+    auto g = GQCG::LibintCommunicator::get().calculateTwoElectronIntegrals(libint2::Operator::coulomb, basis).get_matrix_representation();
+    auto g_packed = GQCG::LibintCommunicator::get().calculateTwoElectronIntegrals(libint2::Operator::coulomb, basis, GQCG::TwoElectronStorage::packed);
+
+
+    // Every integral should be filled in, at all its symmetry-equivalent positions
+    for (size_t p = 0; p < nbf; p++) {
+        for (size_t q = 0; q < nbf; q++) {
+            for (size_t r = 0; r < nbf; r++) {
+                for (size_t s = 0; s < nbf; s++) {
+                    BOOST_CHECK_EQUAL(g(p, q, r, s), g(s, r, q, p));
+                    BOOST_CHECK_EQUAL(g(p, q, r, s), g_packed.get(p, q, r, s));
+                }
+            }
+        }
+        BOOST_CHECK(g(p, p, p, p) > 0.0);
+    }
+
+
+    // Check the integrals against reference integrals that are calculated over all shell quartets, in the original shell order
+    auto libint_atoms = GQCG::LibintCommunicator::get().interface(basis.get_atoms());
+    libint2::BasisSet obs ("6-31G**", libint_atoms);
+    BOOST_REQUIRE_EQUAL(static_cast<size_t>(obs.nbf()), nbf);
+    const auto shell2bf = obs.shell2bf();
+
+    Eigen::Tensor<double, 4> g_ref (nbf, nbf, nbf, nbf);
+    g_ref.setZero();
+    libint2::Engine engine (libint2::Operator::coulomb, obs.max_nprim(), static_cast<int>(obs.max_l()));
+    for (size_t sh1 = 0; sh1 < obs.size(); sh1++) {
+        for (size_t sh2 = 0; sh2 < obs.size(); sh2++) {
+            for (size_t sh3 = 0; sh3 < obs.size(); sh3++) {
+                for (size_t sh4 = 0; sh4 < obs.size(); sh4++) {
+                    engine.compute(obs[sh1], obs[sh2], obs[sh3], obs[sh4]);
+                    auto integrals = engine.results()[0];
+                    if (integrals == nullptr) {
+                        continue;
+                    }
+
+                    for (size_t f1 = 0; f1 < obs[sh1].size(); f1++) {
+                        for (size_t f2 = 0; f2 < obs[sh2].size(); f2++) {
+                            for (size_t f3 = 0; f3 < obs[sh3].size(); f3++) {
+                                for (size_t f4 = 0; f4 < obs[sh4].size(); f4++) {
+                                    g_ref(shell2bf[sh1] + f1, shell2bf[sh2] + f2, shell2bf[sh3] + f3, shell2bf[sh4] + f4) = integrals[f4 + obs[sh4].size() * (f3 + obs[sh3].size() * (f2 + obs[sh2].size() * f1))];
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    BOOST_CHECK(cpputil::linalg::areEqual(g, g_ref, 1.0e-12));
+    BOOST_CHECK(cpputil::linalg::areEqual(g_packed.get_matrix_representation(), g_ref, 1.0e-12));
+}
+
+
+BOOST_AUTO_TEST_CASE ( sparse_one_electron_integrals ) {
+
+    // Two hydrogen molecules that are far apart have (numerically) zero overlap and kinetic integrals between them
+    std::vector<GQCG::Atom> atoms = {
+        {1, 0.0, 0.0, 0.0},
+        {1, 0.0, 0.0, 1.4},
+        {1, 50.0, 0.0, 0.0},
+        {1, 50.0, 0.0, 1.4}
+    };
+    GQCG::Molecule hydrogens (atoms);
+    GQCG::AOBasis basis (hydrogens, "STO-3G");
+
+    auto dense_operators = GQCG::LibintCommunicator::get().calculateOneElectronIntegrals({libint2::Operator::overlap, libint2::Operator::kinetic}, basis);
+    auto sparse_operators = GQCG::LibintCommunicator::get().calculateOneElectronIntegrals({libint2::Operator::overlap, libint2::Operator::kinetic}, basis, GQCG::OneElectronStorage::sparse, 1.0e-12);
+
+    for (size_t i = 0; i < 2; i++) {
+        BOOST_CHECK(sparse_operators[i].get_storage() == GQCG::OneElectronStorage::sparse);
+        BOOST_CHECK_EQUAL(sparse_operators[i].get_sparse_matrix().nonZeros(), 8);  // only the two 2x2 blocks of the molecules
+        BOOST_CHECK(sparse_operators[i].get_matrix_representation().isApprox(dense_operators[i].get_matrix_representation(), 1.0e-10));
+    }
+
+
+    // The sum of sparse operators stays sparse
+    auto sum = sparse_operators[0] + sparse_operators[1];
+    BOOST_CHECK(sum.get_storage() == GQCG::OneElectronStorage::sparse);
+}
+
+
+BOOST_AUTO_TEST_CASE ( integral_derivatives ) {
+
+    // Set up a (bent) water molecule, in Bohr
+    std::vector<GQCG::Atom> atoms = {
+        {8, 0.0, 0.0, 0.2},
+        {1, 0.0, 1.4, -0.9},
+        {1, 0.1, -1.5, -0.8}
+    };
+    GQCG::Molecule water (atoms);
+    GQCG::AOBasis basis (water, "STO-3G");
+    auto nbf = basis.get_number_of_basis_functions();
+
+    auto& libint_communicator = GQCG::LibintCommunicator::get();
+    std::vector<libint2::Operator> one_electron_operator_types {libint2::Operator::overlap, libint2::Operator::kinetic, libint2::Operator::nuclear};
+
+    std::vector<std::vector<GQCG::OneElectronOperator>> one_electron_derivatives;
+    for (const auto& operator_type : one_electron_operator_types) {
+        one_electron_derivatives.push_back(libint_communicator.calculateOneElectronIntegralDerivatives(operator_type, basis));
+        BOOST_CHECK_EQUAL(one_electron_derivatives.back().size(), 9);
+    }
+    auto g_derivatives = libint_communicator.calculateTwoElectronIntegralDerivatives(libint2::Operator::coulomb, basis);
+    auto g_derivatives_packed = libint_communicator.calculateTwoElectronIntegralDerivatives(libint2::Operator::coulomb, basis, GQCG::TwoElectronStorage::packed);
+    BOOST_CHECK_EQUAL(g_derivatives.size(), 9);
+
+    BOOST_CHECK_THROW(libint_communicator.calculateOneElectronIntegralDerivatives(libint2::Operator::coulomb, basis), std::invalid_argument);
+    BOOST_CHECK_THROW(libint_communicator.calculateTwoElectronIntegralDerivatives(libint2::Operator::overlap, basis), std::invalid_argument);
+    BOOST_CHECK_THROW(libint_communicator.calculateTwoElectronIntegralDerivatives(libint2::Operator::coulomb, basis, GQCG::TwoElectronStorage::mixed), std::invalid_argument);
+
+
+    // Check the analytical derivatives with central finite differences
+    double h = 1.0e-04;
+    for (size_t A = 0; A < atoms.size(); A++) {
+        for (size_t x = 0; x < 3; x++) {
+            auto coordinate = 3 * A + x;
+
+            auto atoms_plus = atoms;
+            auto atoms_minus = atoms;
+            double* coordinates_plus[3] = {&atoms_plus[A].x, &atoms_plus[A].y, &atoms_plus[A].z};
+            double* coordinates_minus[3] = {&atoms_minus[A].x, &atoms_minus[A].y, &atoms_minus[A].z};
+            *coordinates_plus[x] += h;
+            *coordinates_minus[x] -= h;
+
+            GQCG::AOBasis basis_plus (GQCG::Molecule(atoms_plus), "STO-3G");
+            GQCG::AOBasis basis_minus (GQCG::Molecule(atoms_minus), "STO-3G");
+
+            auto one_electron_operators_plus = libint_communicator.calculateOneElectronIntegrals(one_electron_operator_types, basis_plus);
+            auto one_electron_operators_minus = libint_communicator.calculateOneElectronIntegrals(one_electron_operator_types, basis_minus);
+            for (size_t i = 0; i < one_electron_operator_types.size(); i++) {
+                Eigen::MatrixXd finite_difference = (one_electron_operators_plus[i].get_matrix_representation() - one_electron_operators_minus[i].get_matrix_representation()) / (2 * h);
+                BOOST_CHECK(one_electron_derivatives[i][coordinate].get_matrix_representation().isApprox(finite_difference, 1.0e-06));
+            }
+
+            auto g_plus = libint_communicator.calculateTwoElectronIntegrals(libint2::Operator::coulomb, basis_plus).get_matrix_representation();
+            auto g_minus = libint_communicator.calculateTwoElectronIntegrals(libint2::Operator::coulomb, basis_minus).get_matrix_representation();
+            Eigen::Tensor<double, 4> g_finite_difference = (g_plus - g_minus) / (2 * h);
+            BOOST_CHECK(cpputil::linalg::areEqual(g_derivatives[coordinate].get_matrix_representation(), g_finite_difference, 1.0e-06));
+            BOOST_CHECK(cpputil::linalg::areEqual(g_derivatives_packed[coordinate].get_matrix_representation(), g_derivatives[coordinate].get_matrix_representation(), 1.0e-12));
+        }
+    }
+
+
+    // Check the translational invariance: the sum of the derivatives over all atoms vanishes
+    for (size_t x = 0; x < 3; x++) {
+        for (const auto& derivatives : one_electron_derivatives) {
+            Eigen::MatrixXd sum = Eigen::MatrixXd::Zero(nbf, nbf);
+            for (size_t A = 0; A < atoms.size(); A++) {
+                sum += derivatives[3 * A + x].get_matrix_representation();
+            }
+            BOOST_CHECK(sum.isZero(1.0e-08));
+        }
+    }
+}
+
+
+BOOST_AUTO_TEST_CASE ( target_accuracy ) {
+
+    // Set up a basis for a water molecule and a distant hydrogen molecule, so that the shell pairs between them are screened
+    GQCG::Molecule water ("../tests/data/h2o.xyz");
+    auto atoms = GQCG::AOBasis(water, "STO-3G").get_atoms();
+    atoms.push_back({1, 0.0, 0.0, 20.0});
+    atoms.push_back({1, 0.0, 1.4, 20.0});
+    GQCG::AOBasis basis (GQCG::Molecule(atoms), "STO-3G");
+    auto K = basis.get_number_of_basis_functions();
+    size_t N_P = 6;  // the number of electron pairs
+
+    auto& libint_communicator = GQCG::LibintCommunicator::get();
+    BOOST_CHECK_THROW(libint_communicator.set_accuracy(0.0), std::invalid_argument);
+    double default_accuracy = libint_communicator.get_accuracy();
+
+
+    // Set up a closed-shell density D = C_occ C_occ^T from the core Hamiltonian guess
+    auto one_electron_operators = libint_communicator.calculateOneElectronIntegrals({libint2::Operator::overlap, libint2::Operator::kinetic, libint2::Operator::nuclear}, basis);
+    Eigen::MatrixXd S = one_electron_operators[0].get_matrix_representation();
+    Eigen::MatrixXd H = one_electron_operators[1].get_matrix_representation() + one_electron_operators[2].get_matrix_representation();
+
+    Eigen::GeneralizedSelfAdjointEigenSolver<Eigen::MatrixXd> eigensolver (H, S);
+    Eigen::MatrixXd C_occupied = eigensolver.eigenvectors().leftCols(N_P);
+    Eigen::MatrixXd D = C_occupied * C_occupied.transpose();
+
+
+    // The two-electron part of the electronic energy is E = sum_pqrs (pq|rs) w_pqrs, with w_pqrs = 2 D_pq D_rs - D_pr D_qs
+    Eigen::Tensor<double, 4> w (K, K, K, K);
+    for (size_t p = 0; p < K; p++) {
+        for (size_t q = 0; q < K; q++) {
+            for (size_t r = 0; r < K; r++) {
+                for (size_t s = 0; s < K; s++) {
+                    w(p, q, r, s) = 2 * D(p, q) * D(r, s) - D(p, r) * D(q, s);
+                }
+            }
+        }
+    }
+    Eigen::Tensor<double, 0> w_norm = w.abs().sum();
+
+    libint_communicator.set_schwarz_threshold(0.0);
+    auto g_ref = libint_communicator.calculateTwoElectronIntegrals(libint2::Operator::coulomb, basis).get_matrix_representation();
+    Eigen::Tensor<double, 0> ref_energy = (g_ref * w).sum();
+
+
+    // Every integral should have an error of at most the target accuracy, so that the energy error is at most
+    // accuracy * sum_pqrs |w_pqrs|. At the looser accuracies, the shell pairs between the molecules should be screened
+    for (double accuracy : {1.0e-10, 1.0e-06, 1.0e-03}) {
+        libint_communicator.set_accuracy(accuracy);
+        BOOST_CHECK_EQUAL(libint_communicator.get_schwarz_threshold(), accuracy);
+
+        auto g = libint_communicator.calculateTwoElectronIntegrals(libint2::Operator::coulomb, basis).get_matrix_representation();
+        if (accuracy >= 1.0e-06) {
+            BOOST_CHECK(libint_communicator.get_number_of_screened_quartets() > 0);
+        }
+
+        Eigen::Tensor<double, 0> max_error = (g - g_ref).abs().maximum();
+        BOOST_CHECK(max_error(0) <= accuracy);
+
+        Eigen::Tensor<double, 0> energy = (g * w).sum();
+        BOOST_CHECK(std::abs(energy(0) - ref_energy(0)) <= accuracy * w_norm(0));
+    }
+
+
+    libint_communicator.set_accuracy(default_accuracy);
+    libint_communicator.set_schwarz_threshold(0.0);
+}
@@ -246,3 +246,50 @@ BOOST_AUTO_TEST_CASE ( methods_water ) {
     // Test the calculation of the nuclear repulsion energy
     BOOST_CHECK(std::abs(water.calculateInternuclearRepulsionEnergy() - ref_internuclear_repulsion_energy) < 1.0e-07);  // reference data from horton
 }
+
+
+BOOST_AUTO_TEST_CASE ( fingerprint ) {
+
+    // Create a fictitious molecule from some Atoms (charge, x, y ,z)
+    std::vector<GQCG::Atom> atoms = {
+        {8, 0.0, -0.143222, 0.0},
+        {1, 1.63803, 1.136549, 0.0},
+        {1, -1.63803, 1.136549, 0.0}
+    };
+    GQCG::Molecule molecule (atoms);
+
+
+    // Rotate the molecule around the z-axis, translate it and reorder its atoms
+    double angle = 0.3;
+    std::vector<GQCG::Atom> transformed_atoms;
+    for (const auto& atom : atoms) {
+        double x = std::cos(angle) * atom.x - std::sin(angle) * atom.y + 1.0;
+        double y = std::sin(angle) * atom.x + std::cos(angle) * atom.y - 2.0;
+        double z = atom.z + 0.5;
+        transformed_atoms.emplace(transformed_atoms.begin(), atom.atomic_number, x, y, z);
+    }
+    GQCG::Molecule transformed_molecule (transformed_atoms);
+
+    BOOST_CHECK(!(molecule == transformed_molecule));
+    BOOST_CHECK_EQUAL(molecule.fingerprint(1.0e-06), transformed_molecule.fingerprint(1.0e-06));
+
+
+    // Check if a different geometry, other atoms or a different charge change the fingerprint
+    std::vector<GQCG::Atom> stretched_atoms = atoms;
+    stretched_atoms[1].x += 0.1;
+    GQCG::Molecule stretched_molecule (stretched_atoms);
+
+    std::vector<GQCG::Atom> substituted_atoms = atoms;
+    substituted_atoms[1].atomic_number = 9;
+    GQCG::Molecule substituted_molecule (substituted_atoms);
+
+    GQCG::Molecule ion (atoms, +1);
+
+    BOOST_CHECK(molecule.fingerprint(1.0e-06) != stretched_molecule.fingerprint(1.0e-06));
+    BOOST_CHECK(molecule.fingerprint(1.0e-06) != substituted_molecule.fingerprint(1.0e-06));
+    BOOST_CHECK(molecule.fingerprint(1.0e-06) != ion.fingerprint(1.0e-06));
+
+
+    // Check if we can't use a zero tolerance
+    BOOST_CHECK_THROW(molecule.fingerprint(0.0), std::invalid_argument);
+}
@@ -81,6 +81,26 @@ BOOST_AUTO_TEST_CASE ( OneElectronOperator_transform_and_inverse ) {
 }
 
 
+BOOST_AUTO_TEST_CASE ( OneElectronOperator_transform_throws ) {
+
+    size_t dim = 3;
+    Eigen::MatrixXd m = Eigen::MatrixXd::Random(dim, dim);
+    GQCG::OneElectronOperator M (m);
+    GQCG::OneElectronOperator M_sparse (Eigen::SparseMatrix<double>(m.sparseView()));
+
+
+    // Check if a transformation matrix whose number of rows isn't the dimension of the operator causes a throw, in both storages
+    Eigen::MatrixXd T = Eigen::MatrixXd::Random(dim + 1, dim);
+    BOOST_CHECK_THROW(M.transform(T), std::invalid_argument);
+    BOOST_CHECK_THROW(M_sparse.transform(T), std::invalid_argument);
+
+
+    // Check if a rectangular transformation matrix with the right number of rows is accepted
+    M.transform(Eigen::MatrixXd::Random(dim, dim - 1));
+    M_sparse.transform(Eigen::MatrixXd::Random(dim, dim - 1));
+}
+
+
 BOOST_AUTO_TEST_CASE ( OneElectronOperator_rotate_throws ) {
 
     // Create a random OneElectronOperator
@@ -120,3 +140,77 @@ BOOST_AUTO_TEST_CASE ( OneElectronOperator_rotate_JacobiRotationParameters ) {
 
     BOOST_CHECK(M1.get_matrix_representation().isApprox(M2.get_matrix_representation(), 1.0e-12));
 }
+
+
+BOOST_AUTO_TEST_CASE ( OneElectronOperator_sparse ) {
+
+    // Create a banded matrix and its sparse representation
+    size_t dim = 6;
+    Eigen::MatrixXd m = Eigen::MatrixXd::Zero(dim, dim);
+    for (size_t i = 0; i < dim; i++) {
+        m(i, i) = i + 1.0;
+        if (i > 0) {
+            m(i, i-1) = 0.5;
+            m(i-1, i) = 0.5;
+        }
+    }
+    Eigen::SparseMatrix<double> sparse_m = m.sparseView();
+
+    GQCG::OneElectronOperator M_sparse (sparse_m);
+    BOOST_CHECK(M_sparse.get_storage() == GQCG::OneElectronStorage::sparse);
+    BOOST_CHECK_EQUAL(M_sparse.get_sparse_matrix().nonZeros(), 3 * dim - 2);
+    BOOST_CHECK_THROW(M_sparse.get_matrix(), std::runtime_error);  // not in the dense storage
+    BOOST_CHECK(M_sparse.get_matrix_representation().isApprox(m, 1.0e-12));
+    BOOST_CHECK_EQUAL(M_sparse.get(2, 1), 0.5);
+    BOOST_CHECK_EQUAL(M_sparse.get(4, 1), 0.0);
+
+
+    // Check the conversions between the storages
+    GQCG::OneElectronOperator M (m);
+    M.sparsify();
+    BOOST_CHECK(M.get_storage() == GQCG::OneElectronStorage::sparse);
+    BOOST_CHECK_EQUAL(M.get_sparse_matrix().nonZeros(), 3 * dim - 2);
+
+    M.sparsify(0.6);  // drop the off-diagonal elements
+    BOOST_CHECK_EQUAL(M.get_sparse_matrix().nonZeros(), dim);
+
+    M.densify();
+    BOOST_CHECK(M.get_storage() == GQCG::OneElectronStorage::dense);
+    BOOST_CHECK(M.get_matrix_representation().isApprox(Eigen::MatrixXd(m.diagonal().asDiagonal()), 1.0e-12));
+
+    BOOST_CHECK_THROW(GQCG::OneElectronOperator (Eigen::SparseMatrix<double>(3, 4)), std::invalid_argument);
+}
+
+
+BOOST_AUTO_TEST_CASE ( OneElectronOperator_sparse_operations ) {
+
+    size_t dim = 5;
+    Eigen::MatrixXd m1 = Eigen::MatrixXd::Random(dim, dim);
+    Eigen::MatrixXd m2 = Eigen::MatrixXd::Random(dim, dim);
+    m1(0, 3) = 0.0;
+
+    GQCG::OneElectronOperator M1 (m1);
+    GQCG::OneElectronOperator M2 (m2);
+    GQCG::OneElectronOperator M1_sparse (Eigen::SparseMatrix<double>(m1.sparseView()));
+    GQCG::OneElectronOperator M2_sparse (Eigen::SparseMatrix<double>(m2.sparseView()));
+
+
+    // Check the sums of all combinations of storages
+    auto sparse_sum = M1_sparse + M2_sparse;
+    BOOST_CHECK(sparse_sum.get_storage() == GQCG::OneElectronStorage::sparse);
+    BOOST_CHECK(sparse_sum.get_matrix_representation().isApprox(m1 + m2, 1.0e-12));
+    BOOST_CHECK((M1_sparse + M2).get_matrix_representation().isApprox(m1 + m2, 1.0e-12));
+    BOOST_CHECK((M1 + M2_sparse).get_matrix_representation().isApprox(m1 + m2, 1.0e-12));
+
+
+    // Check if the transformation and rotation of a sparse representation give the same results as for a dense one
+    Eigen::MatrixXd T = Eigen::MatrixXd::Random(dim, dim);
+    M1.transform(T);
+    M1_sparse.transform(T);
+    BOOST_CHECK(M1_sparse.get_matrix_representation().isApprox(M1.get_matrix_representation(), 1.0e-12));
+
+    GQCG::JacobiRotationParameters jacobi_rotation_parameters (4, 2, 56.81);
+    M2.rotate(jacobi_rotation_parameters);
+    M2_sparse.rotate(jacobi_rotation_parameters);
+    BOOST_CHECK(M2_sparse.get_matrix_representation().isApprox(M2.get_matrix_representation(), 1.0e-12));
+}
@@ -6,6 +6,7 @@
 #include <cpputil.hpp>
 
 #include "miscellaneous.hpp"
+#include "test_utilities.hpp"
 
 #include <boost/test/unit_test.hpp>
 #include <boost/test/included/unit_test.hpp>  // include this to get main(), otherwise the compiler will complain
@@ -116,3 +117,316 @@ BOOST_AUTO_TEST_CASE ( TwoElectronOperator_rotate_JacobiRotationParameters ) {
 
     BOOST_CHECK(cpputil::linalg::areEqual(G1.get_matrix_representation(), G2.get_matrix_representation(), 1.0e-12));
 }
+
+
+BOOST_AUTO_TEST_CASE ( TwoElectronOperator_packed_constructor ) {
+
+    // Check a correct constructor: K = 3 has 6 pairs, so 21 symmetry-unique elements
+    BOOST_CHECK_EQUAL(GQCG::TwoElectronOperator::numberOfPackedElements(3), 21);
+    GQCG::TwoElectronOperator O (Eigen::VectorXd::Zero(21), 3);
+    BOOST_CHECK(O.get_storage() == GQCG::TwoElectronStorage::packed);
+
+
+    // Check a faulty constructor
+    BOOST_CHECK_THROW(GQCG::TwoElectronOperator O2 (Eigen::VectorXd::Zero(20), 3), std::invalid_argument);
+}
+
+
+BOOST_AUTO_TEST_CASE ( TwoElectronOperator_pack_unpack ) {
+
+    size_t K = 4;
+    auto g = randomSymmetricTensor(K);
+    GQCG::TwoElectronOperator G (g);
+
+    G.pack();
+    BOOST_CHECK(G.get_storage() == GQCG::TwoElectronStorage::packed);
+    BOOST_CHECK_EQUAL(G.get_packed_elements().size(), GQCG::TwoElectronOperator::numberOfPackedElements(K));
+    BOOST_CHECK_THROW(G.get_tensor(), std::runtime_error);  // not in the dense storage
+    BOOST_CHECK_THROW(G.get_factors(), std::runtime_error);  // not in the factorized storage
+
+
+    // Check if the packed storage has the same get() semantics
+    for (size_t p = 0; p < K; p++) {
+        for (size_t q = 0; q < K; q++) {
+            for (size_t r = 0; r < K; r++) {
+                for (size_t s = 0; s < K; s++) {
+                    BOOST_CHECK(std::abs(G.get(p, q, r, s) - g(p, q, r, s)) < 1.0e-12);
+                }
+            }
+        }
+    }
+
+    G.unpack();
+    BOOST_CHECK(G.get_storage() == GQCG::TwoElectronStorage::dense);
+    BOOST_CHECK(cpputil::linalg::areEqual(G.get_matrix_representation(), g, 1.0e-12));
+}
+
+
+BOOST_AUTO_TEST_CASE ( TwoElectronOperator_packed_transform_rotate ) {
+
+    size_t K = 5;
+    auto g = randomSymmetricTensor(K);
+    Eigen::MatrixXd T = Eigen::MatrixXd::Random(K, K);
+
+    GQCG::TwoElectronOperator G_dense (g);
+    GQCG::TwoElectronOperator G_packed (g);
+    G_packed.pack();
+
+
+    // Check if a transformation of the packed storage gives the same result as the dense one
+    G_dense.transform(T);
+    G_packed.transform(T);
+    BOOST_CHECK(cpputil::linalg::areEqual(G_packed.get_matrix_representation(), G_dense.get_matrix_representation(), 1.0e-10));
+
+
+    // Check if a Jacobi rotation of the packed storage gives the same result as the dense one
+    GQCG::JacobiRotationParameters jacobi_rotation_parameters (4, 2, 56.81);
+    G_dense.rotate(jacobi_rotation_parameters);
+    G_packed.rotate(jacobi_rotation_parameters);
+    BOOST_CHECK(cpputil::linalg::areEqual(G_packed.get_matrix_representation(), G_dense.get_matrix_representation(), 1.0e-10));
+
+
+    // Check if a transformation matrix with a wrong number of rows is rejected
+    BOOST_CHECK_THROW(G_packed.transform(Eigen::MatrixXd::Random(K-1, K)), std::invalid_argument);
+}
+
+
+BOOST_AUTO_TEST_CASE ( TwoElectronOperator_transform_rectangular ) {
+
+    size_t K = 5;
+    size_t K_new = 3;
+    auto g = randomSymmetricTensor(K);
+    Eigen::MatrixXd T = Eigen::MatrixXd::Random(K, K_new);
+
+
+    // Calculate the reference transformed tensor element by element
+    Eigen::Tensor<double, 4> g_transformed_ref (K_new, K_new, K_new, K_new);
+    g_transformed_ref.setZero();
+    for (size_t p_ = 0; p_ < K_new; p_++) {
+        for (size_t q_ = 0; q_ < K_new; q_++) {
+            for (size_t r_ = 0; r_ < K_new; r_++) {
+                for (size_t s_ = 0; s_ < K_new; s_++) {
+
+                    for (size_t p = 0; p < K; p++) {
+                        for (size_t q = 0; q < K; q++) {
+                            for (size_t r = 0; r < K; r++) {
+                                for (size_t s = 0; s < K; s++) {
+                                    g_transformed_ref(p_, q_, r_, s_) += T(p, p_) * T(q, q_) * T(r, r_) * T(s, s_) * g(p, q, r, s);
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+
+    // Check if every storage gives the reference result, and if the dimension has changed
+    GQCG::TwoElectronOperator G_dense (g);
+    G_dense.transform(T);
+    BOOST_CHECK(cpputil::linalg::areEqual(G_dense.get_matrix_representation(), g_transformed_ref, 1.0e-10));
+
+    GQCG::TwoElectronOperator G_packed (g);
+    G_packed.pack();
+    G_packed.transform(T);
+    BOOST_CHECK(cpputil::linalg::areEqual(G_packed.get_matrix_representation(), g_transformed_ref, 1.0e-10));
+    BOOST_CHECK_EQUAL(G_packed.get_packed_elements().size(), GQCG::TwoElectronOperator::numberOfPackedElements(K_new));
+
+    GQCG::TwoElectronOperator G_mixed (g);
+    G_mixed.compress(1.0e-06);  // the intermediate of the mixed storage is calculated in more than one batch
+    G_mixed.transform(T);
+    BOOST_CHECK(cpputil::linalg::areEqual(G_mixed.get_matrix_representation(), g_transformed_ref, 1.0e-04));
+
+    Eigen::MatrixXd factors (K*K, 1);
+    factors.col(0) = Eigen::VectorXd::Random(K*K);
+    GQCG::TwoElectronOperator G_factorized (factors);
+    GQCG::TwoElectronOperator G_factorized_dense (G_factorized.get_matrix_representation());
+    G_factorized.transform(T);
+    G_factorized_dense.transform(T);
+    BOOST_CHECK(cpputil::linalg::areEqual(G_factorized.get_matrix_representation(), G_factorized_dense.get_matrix_representation(), 1.0e-10));
+
+
+    // Check if the transformed operators can be transformed again with a square transformation matrix of the new dimension
+    Eigen::MatrixXd U = Eigen::MatrixXd::Random(K_new, K_new);
+    G_dense.transform(U);
+    G_packed.transform(U);
+    BOOST_CHECK(cpputil::linalg::areEqual(G_packed.get_matrix_representation(), G_dense.get_matrix_representation(), 1.0e-10));
+    BOOST_CHECK_THROW(G_dense.transform(T), std::invalid_argument);
+}
+
+
+BOOST_AUTO_TEST_CASE ( TwoElectronOperator_transformed ) {
+
+    size_t K = 5;
+    size_t K_new = 3;
+    auto g = randomSymmetricTensor(K);
+    Eigen::MatrixXd T = Eigen::MatrixXd::Random(K, K_new);
+
+    Eigen::MatrixXd factors (K*K, 2);
+    factors.setRandom();
+
+    std::vector<GQCG::TwoElectronOperator> operators {GQCG::TwoElectronOperator(g), GQCG::TwoElectronOperator(g), GQCG::TwoElectronOperator(g), GQCG::TwoElectronOperator(factors)};
+    operators[1].pack();
+    operators[2].compress(1.0e-07);
+
+
+    // Check if transformed() gives the same result as transform() in every storage, and leaves the operator untouched
+    for (const auto& G : operators) {
+        auto G_untouched = G.get_matrix_representation();
+
+        auto G_transformed = G.transformed(T);
+        auto G_ref = G;
+        G_ref.transform(T);
+
+        BOOST_CHECK(G_transformed.get_storage() == G_ref.get_storage());
+        BOOST_CHECK(cpputil::linalg::areEqual(G_transformed.get_matrix_representation(), G_ref.get_matrix_representation(), 1.0e-12));
+        BOOST_CHECK(cpputil::linalg::areEqual(G.get_matrix_representation(), G_untouched, 1.0e-12));
+    }
+
+    BOOST_CHECK_THROW(operators[0].transformed(Eigen::MatrixXd::Random(K_new, K_new)), std::invalid_argument);
+}
+
+
+BOOST_AUTO_TEST_CASE ( TwoElectronOperator_factorized ) {
+
+    // Create some random factors
+    size_t K = 4;
+    size_t M = 6;
+    Eigen::MatrixXd factors (K*K, M);
+    for (size_t L = 0; L < M; L++) {
+        Eigen::MatrixXd factor = Eigen::MatrixXd::Random(K, K);
+        factor = (factor + factor.transpose()).eval();  // the factors are symmetric for real orbitals
+        factors.col(L) = Eigen::Map<Eigen::VectorXd> (factor.data(), K*K);
+    }
+
+    BOOST_CHECK_THROW(GQCG::TwoElectronOperator O (Eigen::MatrixXd::Random(K*K-1, M)), std::invalid_argument);
+    GQCG::TwoElectronOperator G_factorized (factors);
+    BOOST_CHECK(G_factorized.get_storage() == GQCG::TwoElectronStorage::factorized);
+    BOOST_CHECK_EQUAL(G_factorized.get_number_of_factors(), M);
+
+
+    // Check if the elements are given by sum_L L^L_pq L^L_rs
+    auto g = G_factorized.get_matrix_representation();
+    for (size_t p = 0; p < K; p++) {
+        for (size_t q = 0; q < K; q++) {
+            for (size_t r = 0; r < K; r++) {
+                for (size_t s = 0; s < K; s++) {
+                    double ref_value = 0.0;
+                    for (size_t L = 0; L < M; L++) {
+                        ref_value += factors(p + K*q, L) * factors(r + K*s, L);
+                    }
+
+                    BOOST_CHECK(std::abs(G_factorized.get(p, q, r, s) - ref_value) < 1.0e-12);
+                    BOOST_CHECK(std::abs(g(p, q, r, s) - ref_value) < 1.0e-12);
+                }
+            }
+        }
+    }
+
+
+    // Check if transforming and rotating the factors gives the same result as for the dense storage
+    GQCG::TwoElectronOperator G_dense (g);
+    Eigen::MatrixXd T = Eigen::MatrixXd::Random(K, K);
+    G_dense.transform(T);
+    G_factorized.transform(T);
+    BOOST_CHECK(cpputil::linalg::areEqual(G_factorized.get_matrix_representation(), G_dense.get_matrix_representation(), 1.0e-10));
+
+    GQCG::JacobiRotationParameters jacobi_rotation_parameters (3, 1, 0.78);
+    G_dense.rotate(jacobi_rotation_parameters);
+    G_factorized.rotate(jacobi_rotation_parameters);
+    BOOST_CHECK(cpputil::linalg::areEqual(G_factorized.get_matrix_representation(), G_dense.get_matrix_representation(), 1.0e-10));
+
+
+    // Check if the factorized storage can be packed
+    G_factorized.pack();
+    BOOST_CHECK(cpputil::linalg::areEqual(G_factorized.get_matrix_representation(), G_dense.get_matrix_representation(), 1.0e-10));
+}
+
+
+BOOST_AUTO_TEST_CASE ( TwoElectronOperator_mixed ) {
+
+    // Only the diagonal elements (pp|pp) are large enough to be kept in double precision, and a third of the elements is zero
+    size_t K = 5;
+    Eigen::Tensor<double, 4> g = randomSymmetricTensor(K) * 0.1;  // elements in [0, 0.8]
+    for (size_t p = 0; p < K; p++) {
+        for (size_t q = 0; q < K; q++) {
+            for (size_t r = 0; r < K; r++) {
+                for (size_t s = 0; s < K; s++) {
+                    if ((p + q + r + s) % 3 == 0) {  // which respects the permutational symmetry
+                        g(p, q, r, s) = 0.0;
+                    }
+                }
+            }
+        }
+    }
+    for (size_t p = 0; p < K; p++) {
+        g(p, p, p, p) = 10.0;
+    }
+    double error_bound = 1.0e-07;  // so that only elements larger than about 1.7 are kept in double precision
+
+    GQCG::TwoElectronOperator G_dense (g);
+    GQCG::TwoElectronOperator G_mixed (g);
+
+    BOOST_CHECK_THROW(G_mixed.compress(0.0), std::invalid_argument);
+    G_mixed.compress(error_bound);
+    BOOST_CHECK(G_mixed.get_storage() == GQCG::TwoElectronStorage::mixed);
+    BOOST_CHECK_EQUAL(G_mixed.get_error_bound(), error_bound);
+    BOOST_CHECK_EQUAL(G_mixed.get_number_of_double_precision_elements(), K);
+
+
+    // Check if every element is within the error bound
+    for (size_t p = 0; p < K; p++) {
+        for (size_t q = 0; q < K; q++) {
+            for (size_t r = 0; r < K; r++) {
+                for (size_t s = 0; s < K; s++) {
+                    BOOST_CHECK(std::abs(G_mixed.get(p, q, r, s) - g(p, q, r, s)) <= error_bound);
+                    if (g(p, q, r, s) == 0.0) {  // a zero element isn't confused with an element in double precision
+                        BOOST_CHECK_EQUAL(G_mixed.get(p, q, r, s), 0.0);
+                    }
+                }
+            }
+        }
+    }
+    BOOST_CHECK(cpputil::linalg::areEqual(G_mixed.get_matrix_representation(), g, error_bound));
+
+
+    // Check if a transformation of the mixed storage gives the same result as the dense one, up to the rounding errors
+    Eigen::MatrixXd T = Eigen::MatrixXd::Identity(K, K) + 0.01 * Eigen::MatrixXd::Random(K, K);
+    G_dense.transform(T);
+    G_mixed.transform(T);
+    BOOST_CHECK(G_mixed.get_storage() == GQCG::TwoElectronStorage::mixed);
+    BOOST_CHECK(cpputil::linalg::areEqual(G_mixed.get_matrix_representation(), G_dense.get_matrix_representation(), 1.0e-06));
+
+
+    // Check if a Jacobi rotation of the mixed storage gives the same result as the dense one
+    GQCG::JacobiRotationParameters jacobi_rotation_parameters (3, 0, 1.23);
+    G_dense.rotate(jacobi_rotation_parameters);
+    G_mixed.rotate(jacobi_rotation_parameters);
+    BOOST_CHECK(G_mixed.get_storage() == GQCG::TwoElectronStorage::mixed);
+    BOOST_CHECK(cpputil::linalg::areEqual(G_mixed.get_matrix_representation(), G_dense.get_matrix_representation(), 1.0e-06));
+
+
+    // Check if the mixed storage can be unpacked
+    G_mixed.unpack();
+    BOOST_CHECK(G_mixed.get_storage() == GQCG::TwoElectronStorage::dense);
+    BOOST_CHECK(cpputil::linalg::areEqual(G_mixed.get_matrix_representation(), G_dense.get_matrix_representation(), 1.0e-04));
+}
+
+
+BOOST_AUTO_TEST_CASE ( TwoElectronOperator_mixed_fallback ) {
+
+    // About half of the elements in [0, 8] are larger than about 4.2, so the mixed storage wouldn't be smaller than the packed one
+    size_t K = 5;
+    auto g = randomSymmetricTensor(K);
+    GQCG::TwoElectronOperator G (g);
+
+    G.compress(2.5e-07);
+    BOOST_CHECK(G.get_storage() == GQCG::TwoElectronStorage::packed);
+    BOOST_CHECK(cpputil::linalg::areEqual(G.get_matrix_representation(), g, 1.0e-12));  // the packed storage isn't rounded
+
+
+    // Check the break-even point: a correction takes 16 bytes, while it saves 4 bytes for every element
+    BOOST_CHECK(GQCG::TwoElectronOperator::isMixedStorageSmaller(100, 24));
+    BOOST_CHECK(!GQCG::TwoElectronOperator::isMixedStorageSmaller(100, 25));
+}
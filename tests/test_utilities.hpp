@@ -0,0 +1,73 @@
+#ifndef GQCG_TEST_UTILITIES_HPP
+#define GQCG_TEST_UTILITIES_HPP
+
+
+#include <memory>
+
+#include <Eigen/Dense>
+#include <unsupported/Eigen/CXX11/Tensor>
+
+#include "AOBasis.hpp"
+#include "HamiltonianParameters/HamiltonianParameters.hpp"
+
+
+
+/**
+ *  @return a random rank-4 tensor of dimension @param K that has the 8-fold permutational symmetry of two-electron integrals
+ */
+inline Eigen::Tensor<double, 4> randomSymmetricTensor(long K) {
+
+    Eigen::Tensor<double, 4> g (K, K, K, K);
+    g.setRandom();
+
+    Eigen::Tensor<double, 4> g_symmetric (K, K, K, K);
+    for (long p = 0; p < K; p++) {
+        for (long q = 0; q < K; q++) {
+            for (long r = 0; r < K; r++) {
+                for (long s = 0; s < K; s++) {
+                    g_symmetric(p, q, r, s) = g(p, q, r, s) + g(q, p, r, s) + g(p, q, s, r) + g(q, p, s, r)
+                                            + g(r, s, p, q) + g(s, r, p, q) + g(r, s, q, p) + g(s, r, q, p);
+                }
+            }
+        }
+    }
+
+    return g_symmetric;
+}
+
+
+/**
+ *  @return the STO-3G basis of the water molecule in tests/data/h2o.xyz, which has 7 basis functions
+ */
+inline GQCG::AOBasis_sptr waterSTO3GBasis() {
+
+    GQCG::Molecule water ("../tests/data/h2o.xyz");
+    return std::make_shared<GQCG::AOBasis>(water, "STO-3G");
+}
+
+
+/**
+ *  @return HamiltonianParameters in the given @param ao_basis_sptr with random operators and a random transformation
+ *  matrix
+ *
+ *  The overlap is the identity matrix, the one-electron operator is symmetric and the (dense) two-electron operator has
+ *  the permutational symmetry of two-electron integrals
+ */
+inline GQCG::HamiltonianParameters randomHamiltonianParameters(GQCG::AOBasis_sptr ao_basis_sptr) {
+
+    auto K = static_cast<long>(ao_basis_sptr->get_number_of_basis_functions());
+
+    Eigen::MatrixXd h_matrix = Eigen::MatrixXd::Random(K, K);
+    h_matrix = (h_matrix + h_matrix.transpose()).eval();
+
+    GQCG::OneElectronOperator S (Eigen::MatrixXd::Identity(K, K));
+    GQCG::OneElectronOperator h (std::move(h_matrix));
+    GQCG::TwoElectronOperator g (randomSymmetricTensor(K));
+    Eigen::MatrixXd C = Eigen::MatrixXd::Random(K, K);
+
+    return GQCG::HamiltonianParameters(std::move(ao_basis_sptr), std::move(S), std::move(h), std::move(g), std::move(C));
+}
+
+
+
+#endif  // GQCG_TEST_UTILITIES_HPP